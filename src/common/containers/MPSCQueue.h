@@ -0,0 +1,128 @@
+#ifndef __MPSC_QUEUE_H__
+#define __MPSC_QUEUE_H__
+
+#include <atomic>
+#include <limits>
+#include <utility>
+
+// Unbounded lock-free multi-producer/single-consumer queue.
+// add() may be called from any thread. next(), peek(), drain(), empty() and clear() must not be
+// called concurrently, the consumers must be externally serialized. Consumers on several threads
+// may take turns, e.g. the world thread and the theater worker that both process the received
+// packets of a session, as long as each turn happens-before the next one.
+// An element added by a producer that is preempted in the middle of add() becomes visible
+// to the consumer once that producer resumes, so empty() may briefly report true
+template<typename T>
+class MPSCQueue
+{
+	struct Node
+	{
+		Node() : next(nullptr) { }
+		explicit Node(T&& v) : next(nullptr), value(std::move(v)) { }
+		explicit Node(T const& v) : next(nullptr), value(v) { }
+
+		std::atomic<Node*> next;
+		T value;
+	};
+
+public:
+	MPSCQueue() :
+		m_head(new Node()),
+		m_tail(m_head.load(std::memory_order_relaxed))
+	{
+	}
+
+	~MPSCQueue()
+	{
+		this->clear();
+		delete m_tail;
+	}
+
+	MPSCQueue(MPSCQueue const& right) = delete;
+	MPSCQueue& operator=(MPSCQueue const& right) = delete;
+
+	void add(T&& element)
+	{
+		this->push(new Node(std::move(element)));
+	}
+
+	void add(T const& element)
+	{
+		this->push(new Node(element));
+	}
+
+	bool next(T& result)
+	{
+		Node* tail = m_tail;
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+
+		// The next node becomes the new stub, its value has been moved out
+		result = std::move(next->value);
+		next->value = T();
+		m_tail = next;
+		delete tail;
+
+		return true;
+	}
+
+	// Returns the element next() would remove without removing it, or nullptr if the queue is empty
+	T* peek()
+	{
+		Node* next = m_tail->next.load(std::memory_order_acquire);
+		return next ? &next->value : nullptr;
+	}
+
+	// Pass up to maxCount elements to the consumer in FIFO order, the consumer is called
+	// with a reference to each element and may move from it. Returns the number of elements consumed
+	template<typename Consumer>
+	std::size_t drain(Consumer&& consumer, std::size_t maxCount = std::numeric_limits<std::size_t>::max())
+	{
+		std::size_t count = 0;
+		Node* tail = m_tail;
+		while (count < maxCount)
+		{
+			Node* next = tail->next.load(std::memory_order_acquire);
+			if (!next)
+				break;
+
+			consumer(next->value);
+			next->value = T();
+			m_tail = next;
+			delete tail;
+			tail = next;
+			++count;
+		}
+
+		return count;
+	}
+
+	void clear()
+	{
+		T element;
+		while (this->next(element))
+			;
+	}
+
+	bool empty() const
+	{
+		return m_tail->next.load(std::memory_order_acquire) == nullptr;
+	}
+
+private:
+	void push(Node* node)
+	{
+		Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// Producers append at the head, the consumer removes from the tail.
+	// The padding keeps them on separate cache lines to avoid false sharing
+	std::atomic<Node*> m_head;
+	char m_padding[64 - sizeof(std::atomic<Node*>)];
+	Node* m_tail;
+};
+
+
+#endif // __MPSC_QUEUE_H__
@@ -0,0 +1,70 @@
+#include "AdmissionControl.h"
+
+AdmissionControl::AdmissionControl() :
+	m_perIpRate(0.0),
+	m_perIpBurst(0.0),
+	m_globalRate(0.0),
+	m_lastPurgeTime(0)
+{
+}
+
+void AdmissionControl::configure(double perIpRate, double perIpBurst, double globalRate, double globalBurst)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_perIpRate = perIpRate;
+	m_perIpBurst = std::max(perIpBurst, 1.0);
+	m_globalRate = globalRate;
+	m_globalBucket = TokenBucket(globalRate, std::max(globalBurst, 1.0), 0);
+	m_buckets.clear();
+}
+
+AdmissionResult AdmissionControl::admit(boost::asio::ip::address const& address, int64 now)
+{
+	std::string key;
+	if (address.is_v4())
+	{
+		auto bytes = address.to_v4().to_bytes();
+		key.assign(bytes.begin(), bytes.end());
+	}
+	else
+	{
+		// A client usually owns a whole /64 prefix, so it could otherwise open each connection from a new address
+		auto bytes = address.to_v6().to_bytes();
+		key.assign(bytes.begin(), bytes.begin() + IPV6_PREFIX_BYTES);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_perIpRate > 0.0)
+	{
+		// Addresses whose bucket has refilled behave the same as unknown addresses, so they can be forgotten
+		if (now - m_lastPurgeTime >= PURGE_INTERVAL)
+		{
+			for (auto it = m_buckets.begin(); it != m_buckets.end();)
+			{
+				if ((*it).second.isFull(now))
+					it = m_buckets.erase(it);
+				else
+					++it;
+			}
+			m_lastPurgeTime = now;
+		}
+
+		auto it = m_buckets.find(key);
+		if (it == m_buckets.end() && m_buckets.size() < MAX_TRACKED_ADDRESSES)
+			it = m_buckets.emplace(key, TokenBucket(m_perIpRate, m_perIpBurst, now)).first;
+
+		// When the table is full, a new address is only limited by the global bucket. Shedding it instead 
+		// would turn a flood of addresses into an outage for every client that connects until the next purge
+		if (it != m_buckets.end() && !(*it).second.consume(now))
+			return ADMISSION_SHED_PER_IP;
+	}
+
+	// A connection shed by its address limit does not take a global token, so a single
+	// abusive address cannot lock out the other clients
+	if (m_globalRate > 0.0 && !m_globalBucket.consume(now))
+		return ADMISSION_SHED_GLOBAL;
+
+	return ADMISSION_ACCEPTED;
+}
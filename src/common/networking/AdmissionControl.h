@@ -0,0 +1,57 @@
+#ifndef __ADMISSION_CONTROL_H__
+#define __ADMISSION_CONTROL_H__
+
+#include <mutex>
+#include <unordered_map>
+
+#include <boost/asio/ip/address.hpp>
+
+#include "Common.h"
+#include "utilities/TokenBucket.h"
+
+enum AdmissionResult
+{
+	ADMISSION_ACCEPTED,
+	// The connection rate of the remote address is over its limit
+	ADMISSION_SHED_PER_IP,
+	// The connection rate of all addresses together is over the limit
+	ADMISSION_SHED_GLOBAL
+};
+
+// Connection admission control applied by the acceptors before a socket object is created
+// for a new connection. Each remote address has a token bucket, and all connections share
+// a global bucket, so a reconnect storm or an abusive client is shed at the cost of an
+// accept and a close. A rate of 0 disables the corresponding limit. Thread-safe
+class AdmissionControl
+{
+public:
+	enum
+	{
+		// Buckets of idle addresses are purged at this interval (in microseconds)
+		PURGE_INTERVAL = 10 * 1000000,
+		// When this many addresses are tracked, connections from new addresses are only 
+		// limited by the global bucket until the next purge
+		MAX_TRACKED_ADDRESSES = 100000,
+		// An IPv6 address is tracked by its /64 prefix
+		IPV6_PREFIX_BYTES = 8
+	};
+
+	AdmissionControl();
+
+	void configure(double perIpRate, double perIpBurst, double globalRate, double globalBurst);
+
+	// Decide whether to accept a connection from the address. The time is in microseconds, e.g. getSteadyTimeMicros()
+	AdmissionResult admit(boost::asio::ip::address const& address, int64 now);
+
+private:
+	std::mutex m_mutex;
+	double m_perIpRate;
+	double m_perIpBurst;
+	double m_globalRate;
+	TokenBucket m_globalBucket;
+	// Keyed by the raw bytes of the address, or of the /64 prefix of an IPv6 address
+	std::unordered_map<std::string, TokenBucket> m_buckets;
+	int64 m_lastPurgeTime;
+};
+
+#endif // __ADMISSION_CONTROL_H__
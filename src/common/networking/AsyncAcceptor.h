@@ -3,22 +3,33 @@
 
 #include <functional>
 #include <atomic>
+#include <future>
+#include <memory>
 
 #include <boost/asio.hpp>
 
 #include "logging/Log.h"
+#include "utilities/TimeUtil.h"
+#include "NetworkStats.h"
+#include "AdmissionControl.h"
 
 
 
 using boost::asio::ip::tcp;
 
 
-class AsyncAcceptor
+// Must be owned by a std::shared_ptr, the pending accept handler keeps the acceptor alive.
+// The handlers run on a strand, so the io_service may be run by several threads
+class AsyncAcceptor : public std::enable_shared_from_this<AsyncAcceptor>
 {
 public:
 	AsyncAcceptor(boost::asio::io_service& ioService) :
 		m_tcpNoDelay(false),
+		m_reusePort(false),
 		m_sendBufferSize(-1),
+		m_admissionControl(nullptr),
+		m_ioService(ioService),
+		m_strand(ioService),
 		m_acceptor(ioService),
 		m_closed(true)
     {
@@ -26,7 +37,7 @@ public:
 
 	~AsyncAcceptor()
 	{
-		this->close();
+		this->closeAcceptor();
 	}
 
 	// Set the kernel send buffer size. -1 uses the system default value
@@ -34,6 +45,24 @@ public:
 
 	void setTcpNoDelay(bool noDelay) { m_tcpNoDelay = noDelay; }
 
+	// Allow several acceptors to listen on the same address and port (SO_REUSEPORT). 
+	// The kernel distributes new connections between them. Must be set before listen()
+	void setReusePort(bool reusePort) { m_reusePort = reusePort; }
+
+	// Check each new connection against the admission control before it is handed to the accept callback.
+	// nullptr accepts every connection
+	void setAdmissionControl(AdmissionControl* admissionControl) { m_admissionControl = admissionControl; }
+
+	// Returns true if the platform supports SO_REUSEPORT
+	static bool isReusePortSupported()
+	{
+#ifdef SO_REUSEPORT
+		return true;
+#else
+		return false;
+#endif
+	}
+
 	bool setSocketOptions()
 	{
 		boost::system::error_code ec;
@@ -45,6 +74,19 @@ public:
 		//	return false;
 		//}
 
+#ifdef SO_REUSEPORT
+		if (m_reusePort)
+		{
+			typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+			m_acceptor.set_option(reuse_port(true), ec);
+			if (ec)
+			{
+				NS_LOG_ERROR("network.acceptor", "Acceptor set option(reuse_port) failed. err = %s", ec.message().c_str());
+				return false;
+			}
+		}
+#endif
+
 		if (m_sendBufferSize >= 0)
 		{
 			m_acceptor.set_option(boost::asio::socket_base::send_buffer_size(m_sendBufferSize), ec);
@@ -122,30 +164,76 @@ public:
 		this->accept();
     }
 
+	// Close the acceptor on its strand and wait until it is closed. An accept handler that is running finishes first, 
+	// and the accept callback is not called afterwards. If the io_service has been stopped, the acceptor is closed 
+	// on the calling thread. Must not be called from a thread that runs the io_service
     void close()
     {
-        if (m_closed.exchange(true))
-            return;
+		if (m_ioService.stopped())
+		{
+			this->closeAcceptor();
+			return;
+		}
+
+		std::promise<void> closed;
+		std::shared_ptr<AsyncAcceptor> self = this->shared_from_this();
+		m_strand.post([self, &closed]() {
+			self->closeAcceptor();
+			closed.set_value();
+		});
+		closed.get_future().wait();
+    }
 
-        boost::system::error_code error;
-        m_acceptor.close(error);
+private:
+	void closeAcceptor()
+	{
+		if (m_closed.exchange(true))
+			return;
+
+		boost::system::error_code error;
+		m_acceptor.close(error);
 		if (error)
 		{
 			std::string emsg = error.message();
 			NS_LOG_WARN("network.acceptor", "close() error(%d):%s", error.value(), emsg.c_str());
 		}
-    }
+	}
+
+	// Returns false if the connection was shed, the socket is closed and can be used for the next accept
+	bool admit(tcp::socket& socket)
+	{
+		if (!m_admissionControl)
+			return true;
+
+		// A connection that is already gone is left to the accept callback, which reports it
+		boost::system::error_code ec;
+		tcp::endpoint remote = socket.remote_endpoint(ec);
+		if (ec)
+			return true;
+
+		AdmissionResult result = m_admissionControl->admit(remote.address(), getSteadyTimeMicros());
+		if (result == ADMISSION_ACCEPTED)
+			return true;
+
+		sNetworkStats->addShedConnection(result);
+		NS_LOG_DEBUG("network.acceptor", "Connection from %s:%d shed by the %s admission limit",
+			remote.address().to_string().c_str(), remote.port(), result == ADMISSION_SHED_PER_IP ? "per-IP" : "global");
+
+		socket.close(ec);
+		return false;
+	}
 
-private:
 	void accept()
 	{
 		tcp::socket* socket;
 		uint32 threadIndex;
 		std::tie(socket, threadIndex) = m_socketFactory();
-		m_acceptor.async_accept(*socket, [this, socket, threadIndex](boost::system::error_code error)
+		std::shared_ptr<AsyncAcceptor> self = this->shared_from_this();
+		m_acceptor.async_accept(*socket, m_strand.wrap([this, self, socket, threadIndex](boost::system::error_code error)
 		{
-			if (!error)
+			if (!error && this->admit(*socket))
 			{
+				sNetworkStats->addAccept();
 				try
 				{
 					m_acceptCallback(std::move(*socket), threadIndex);
@@ -158,13 +246,17 @@ private:
 
 			if (!m_closed)
 				this->accept();
-		});
+		}));
 	}
 
 
 	bool m_tcpNoDelay;
+	bool m_reusePort;
 	int32 m_sendBufferSize;
+	AdmissionControl* m_admissionControl;
 
+	boost::asio::io_service& m_ioService;
+	boost::asio::io_service::strand m_strand;
     tcp::acceptor m_acceptor;
     std::atomic<bool> m_closed;
 
@@ -4,9 +4,13 @@
 #include <iomanip>
 
 #include <google/protobuf/message_lite.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/io/coded_stream.h>
 
 #include "logging/Log.h"
 #include "MessageBuffer.h"
+#include "BufferPool.h"
+#include "SharedPayload.h"
 
 using google::protobuf::MessageLite;
 
@@ -32,23 +36,38 @@ public:
 		// Data header byte length = body (2 bytes) + opcode (2 bytes)
 		HEADER_BYTE_SIZE = 4,
 
-		// Maximum allowed body data length
+		// Maximum allowed body data length of a frame
 		MAX_BODY_BYTE_SIZE = 8192,
 
+		// Maximum allowed body data length of a packet streamed across continuation frames
+		MAX_STREAM_BYTE_SIZE = 262144,
+
 		// Invalid opcode
 		INVALID_OPCODE = 0,
 
 		// Default buffer size
-		DEFAULT_BUFFER_SIZE = 1024
+		DEFAULT_BUFFER_SIZE = 1024,
+
+		// Set in the opcode of a compressed packet. The body of a compressed packet is the 
+		// uncompressed body length (4 bytes, big-endian) followed by the zlib stream of the body
+		COMPRESSED_OPCODE_FLAG = 0x8000,
 
+		// Set in the opcode of every frame of a packet except the last one. A packet whose body is larger 
+		// than MAX_BODY_BYTE_SIZE is sent as consecutive frames with the same opcode, and each frame except 
+		// the last one carries exactly MAX_BODY_BYTE_SIZE bytes of the body
+		CONTINUATION_OPCODE_FLAG = 0x4000
 	};
 
 	BasicPacket() :
 		m_bodySize(0),
 		m_opcode(INVALID_OPCODE),
+		m_isContinued(false),
 		m_bufferSize(0),
 		m_buffer(nullptr),
-		m_timestamp(0)
+		m_borrowedBody(nullptr),
+		m_timestamp(0),
+		m_isDatagram(false),
+		m_datagramSequence(0)
 	{
 
 	}
@@ -56,18 +75,26 @@ public:
 	explicit BasicPacket(uint16 opcode) :
 		m_bodySize(0),
 		m_opcode(opcode),
+		m_isContinued(false),
 		m_bufferSize(0),
 		m_buffer(nullptr),
-		m_timestamp(0)
+		m_borrowedBody(nullptr),
+		m_timestamp(0),
+		m_isDatagram(false),
+		m_datagramSequence(0)
 	{
 	}
 
 	BasicPacket(BasicPacket&& right) :
 		m_bodySize(0),
 		m_opcode(INVALID_OPCODE),
+		m_isContinued(false),
 		m_bufferSize(0),
 		m_buffer(nullptr),
-		m_timestamp(0)
+		m_borrowedBody(nullptr),
+		m_timestamp(0),
+		m_isDatagram(false),
+		m_datagramSequence(0)
 	{
 		this->move(right);
 	}
@@ -88,41 +115,136 @@ public:
 		this->deallocBuffer();
 	}
 
+	// Serialize the message into the body. A message larger than MAX_BODY_BYTE_SIZE is serialized
+	// straight into the buffers of its frames. If the message is larger than MAX_STREAM_BYTE_SIZE, 
+	// a PacketException exception will be thrown.
 	void pack(MessageLite const& message)
 	{
-		m_bodySize = static_cast<uint16>(message.ByteSizeLong());
-		this->allocBufferIfNeeded(m_bodySize);
+		std::size_t size = message.ByteSizeLong();
+		if (size > MAX_STREAM_BYTE_SIZE)
+			throw PacketException(StringUtil::format("Message(%s) of %d bytes > MAX_STREAM_BYTE_SIZE(%d)", message.GetTypeName().c_str(), static_cast<int32>(size), MAX_STREAM_BYTE_SIZE));
 
-		message.SerializeWithCachedSizesToArray(this->getBodyPointer());
+		m_bodySize = static_cast<uint32>(size);
+		this->allocBody(m_bodySize);
+
+		if (this->getFrameCount() == 1)
+			message.SerializeWithCachedSizesToArray(this->getBodyPointer());
+		else
+		{
+			FrameOutputStream stream(*this);
+			google::protobuf::io::CodedOutputStream output(&stream);
+			message.SerializeWithCachedSizes(&output);
+		}
 	}
 
 
 	void unpack(MessageLite& message) const
 	{
 		bool noerror = true;
-		if (this->hasBody())
-			noerror = message.ParseFromArray(this->getBodyPointer(), this->getBodyBytes());
+		if (this->getFrameCount() > 1)
+		{
+			FrameInputStream stream(*this);
+			noerror = message.ParseFromZeroCopyStream(&stream);
+		}
+		else if (this->hasBody())
+			noerror = message.ParseFromArray(this->getBodyData(), this->getBodyBytes());
 
 		if (!noerror)
 			throw PacketException(StringUtil::format("Message(%s) to parsing data failed. %s", message.GetTypeName().c_str(), this->description().c_str()));
 	}
 
 
-	// Write data to MessageBuffer
-	void write(MessageBuffer& buff)
+	// Encode the headers of all frames into the internal header storage. The header and body of 
+	// each frame can then be passed to a gather write as two buffers without being copied into a MessageBuffer
+	void encodeHeader()
+	{
+		uint32 frameCount = this->getFrameCount();
+		if (frameCount == 1)
+		{
+			m_frameHeaders.clear();
+			this->encodeFrameHeader(0, m_header);
+			return;
+		}
+
+		m_frameHeaders.resize(frameCount * HEADER_BYTE_SIZE);
+		for (uint32 i = 0; i < frameCount; ++i)
+			this->encodeFrameHeader(i, &m_frameHeaders[i * HEADER_BYTE_SIZE]);
+	}
+	uint8 const* getHeaderPointer(uint32 frame = 0) const { return m_frameHeaders.empty() ? m_header : &m_frameHeaders[frame * HEADER_BYTE_SIZE]; }
+
+	// Returns the body of the first frame. Only a packet with a single frame has a contiguous body
+	uint8 const* getBodyData() const
 	{
-		this->encodeHeader(buff.getWritePointer());
-		buff.writeCompleted(HEADER_BYTE_SIZE);
+		if (m_sharedBody)
+			return m_sharedBody->getData();
 
-		if (this->hasBody())
+		return m_borrowedBody ? m_borrowedBody : m_buffer;
+	}
+
+	// A body larger than MAX_BODY_BYTE_SIZE is split into frames, which are written, read and stored separately
+	uint32 getFrameCount() const { return m_bodySize > MAX_BODY_BYTE_SIZE ? (m_bodySize + MAX_BODY_BYTE_SIZE - 1) / MAX_BODY_BYTE_SIZE : 1; }
+	uint32 getFrameBodyBytes(uint32 frame) const { return std::min<uint32>(m_bodySize - frame * MAX_BODY_BYTE_SIZE, MAX_BODY_BYTE_SIZE); }
+	uint8 const* getFrameBodyData(uint32 frame) const
+	{
+		if (m_sharedBody)
+			return m_sharedBody->getData() + frame * MAX_BODY_BYTE_SIZE;
+
+		// A borrowed body always has a single frame
+		if (m_borrowedBody)
+			return m_borrowedBody;
+
+		return frame == 0 ? m_buffer : m_frameBuffers[frame - 1].first;
+	}
+
+	// Replace the body with a copy of the specified data
+	void setBody(uint8 const* data, uint32 size)
+	{
+		m_bodySize = size;
+		this->allocBody(size);
+		for (uint32 i = 0, frameCount = this->getFrameCount(); i < frameCount; ++i)
 		{
-			memcpy(buff.getWritePointer(), this->getBodyPointer(), this->getBodyBytes());
-			buff.writeCompleted(this->getBodyBytes());
+			if (this->getFrameBodyBytes(i) > 0)
+				std::memcpy(this->getFrameBodyPointer(i), data + i * MAX_BODY_BYTE_SIZE, this->getFrameBodyBytes(i));
+		}
+	}
+
+	// Reference a body that is shared with other packets instead of owning a copy.
+	// The body is released when the packet is destroyed or a new body is set
+	void setSharedBody(SharedPayloadPtr const& payload)
+	{
+		this->deallocBuffer();
+		this->releaseBorrowedBody();
+		m_sharedBody = payload;
+		m_bodySize = payload ? payload->getSize() : 0;
+	}
 
+	bool isSharedBody() const { return m_sharedBody != nullptr; }
+
+	// Write all frames to MessageBuffer
+	void write(MessageBuffer& buff)
+	{
+		for (uint32 i = 0, frameCount = this->getFrameCount(); i < frameCount; ++i)
+		{
+			this->encodeFrameHeader(i, buff.getWritePointer());
+			buff.writeCompleted(HEADER_BYTE_SIZE);
+
+			uint32 frameBytes = this->getFrameBodyBytes(i);
+			if (frameBytes > 0)
+			{
+				memcpy(buff.getWritePointer(), this->getFrameBodyData(i), frameBytes);
+				buff.writeCompleted(frameBytes);
+			}
 		}
 	}
 
-	// Read header data from MessageBuffer.
+	// Returns the body length stored in the header of a frame without validating it
+	static uint16 peekBodyBytes(uint8 const* headerPtr)
+	{
+		return static_cast<uint16>(((headerPtr[0] << 8) & 0xFF00) | (headerPtr[1] & 0xFF));
+	}
+
+	// Read the header of a frame from MessageBuffer. The continuation flag is removed from the opcode, see isContinued().
+	// The packet takes the timestamp of the buffer, which the socket sets to the time the data was read.
 	// If the opcode value range or body data length is invalid, a PacketException exception will be thrown.
 	void decodeHeader(MessageBuffer& buff)
 	{
@@ -142,6 +264,14 @@ public:
 		}
 
 
+		// A frame followed by continuation frames always carries a full body
+		bool isContinued = (opcode & CONTINUATION_OPCODE_FLAG) != 0;
+		opcode &= ~CONTINUATION_OPCODE_FLAG;
+		if (isContinued && size != MAX_BODY_BYTE_SIZE)
+		{
+			throw PacketException(StringUtil::format("Failed to decode packet because body bytes(%d) of continued frame != MAX_BODY_BYTE_SIZE(%d)", size, MAX_BODY_BYTE_SIZE));
+		}
+
 		// Invalid opcode value range
 		if (opcode >= NUM_MSG_TYPES)
 		{
@@ -151,6 +281,8 @@ public:
 		m_bodySize = size;
 
 		m_opcode = opcode;
+		m_isContinued = isContinued;
+		m_timestamp = buff.getTimestamp();
 		buff.readCompleted(HEADER_BYTE_SIZE);
 	}
 
@@ -159,28 +291,84 @@ public:
 		if (!hasBody())
 			return;
 
-		this->allocBufferIfNeeded(this->getBodyBytes());
+		m_timestamp = buff.getTimestamp();
+		this->allocBody(this->getBodyBytes());
 		std::memcpy(this->getBodyPointer(), buff.getReadPointer(), this->getBodyBytes());
 
 		buff.readCompleted(this->getBodyBytes());
 	}
 
+	// Reference the body at the read position of a receive buffer instead of copying it, so the message
+	// is parsed straight from the received bytes. The buffer is shared by all packets borrowed from it and is 
+	// kept alive until the packet is destroyed or a new body is set. The owner of the buffer must not 
+	// overwrite it while it is shared. Only a frame that is not continued can be borrowed
+	void borrowBody(std::shared_ptr<MessageBuffer> const& buff)
+	{
+		NS_ASSERT(!m_isContinued);
+
+		if (!hasBody())
+			return;
+
+		this->deallocBuffer();
+		m_sharedBody.reset();
+		m_timestamp = buff->getTimestamp();
+		m_borrowedBuffer = buff;
+		m_borrowedBody = buff->getReadPointer();
+
+		buff->readCompleted(this->getBodyBytes());
+	}
+
+	bool isBorrowedBody() const { return m_borrowedBody != nullptr; }
+
+	// Returns true if the decoded frame is followed by continuation frames of the same packet
+	bool isContinued() const { return m_isContinued; }
+
+	// Append the body of the next decoded frame of a packet streamed across continuation frames. 
+	// The buffer of the frame is taken over, the body is not copied. If the opcode differs or the 
+	// body would exceed MAX_STREAM_BYTE_SIZE, a PacketException exception will be thrown.
+	void appendFrame(BasicPacket&& frame)
+	{
+		NS_ASSERT(m_isContinued && !m_sharedBody && !frame.m_borrowedBody && m_bodySize % MAX_BODY_BYTE_SIZE == 0);
+
+		if (frame.getOpcode() != m_opcode)
+			throw PacketException(StringUtil::format("Failed to decode packet because continuation frame opcode(0x%X) != opcode(0x%X)", frame.getOpcode(), m_opcode));
+
+		if (m_bodySize + frame.getBodyBytes() > MAX_STREAM_BYTE_SIZE)
+			throw PacketException(StringUtil::format("Failed to decode packet because body bytes(%d) > MAX_STREAM_BYTE_SIZE(%d)", m_bodySize + frame.getBodyBytes(), MAX_STREAM_BYTE_SIZE));
+
+		if (frame.hasBody())
+		{
+			m_frameBuffers.emplace_back(frame.m_buffer, frame.m_bufferSize);
+			m_bodySize += frame.m_bodySize;
+			frame.m_buffer = nullptr;
+			frame.m_bufferSize = 0;
+			frame.m_bodySize = 0;
+		}
+
+		m_isContinued = frame.m_isContinued;
+		m_timestamp = frame.m_timestamp;
+	}
+
 	void setOpcode(uint16 opcode) { m_opcode = opcode; }
 	uint16 getOpcode() const { return m_opcode; }
 
 	bool hasBody() const { return m_bodySize > 0; }
-	uint16 getBodyBytes() const { return m_bodySize; }
+	uint32 getBodyBytes() const { return m_bodySize; }
 
-	uint16 getByteSize() const { return HEADER_BYTE_SIZE + m_bodySize; }
-    uint16 getBufferSize() const { return m_bufferSize;}
+	// Returns the number of bytes of all frames on the wire
+	uint32 getByteSize() const { return this->getFrameCount() * HEADER_BYTE_SIZE + m_bodySize; }
+    uint32 getBufferSize() const { return m_bufferSize;}
 
 	void setTimestamp(int64 timestamp) { m_timestamp = timestamp; }
 	int64 getTimestamp() const { return m_timestamp; }
 
+	// Marks a packet received in a datagram instead of over the stream, with the sequence of the datagram
+	void setDatagramSequence(uint32 sequence) { m_isDatagram = true; m_datagramSequence = sequence; }
+	bool isDatagram() const { return m_isDatagram; }
+	uint32 getDatagramSequence() const { return m_datagramSequence; }
+
 	std::string description() const
 	{
-		uint8* bodyPtr = this->getBodyPointer();
-
 		std::stringstream ss;
 		ss << std::setfill('0');
 		ss << std::hex;
@@ -192,12 +380,12 @@ public:
 		ss << ", data: \n";
 		ss << std::hex;
 		int32 addr = 0;
-		for (int32 i = 0; i < m_bodySize; ++i)
+		for (uint32 i = 0; i < m_bodySize; ++i)
 		{
 			if (i % 16 == 0)
 				ss << "\t0x" << std::setw(4) << addr << ": ";
 
-			ss << std::setw(2) << (int32)(*bodyPtr++);
+			ss << std::setw(2) << (int32)this->getFrameBodyData(i / MAX_BODY_BYTE_SIZE)[i % MAX_BODY_BYTE_SIZE];
 			if ((i + 1) % 16 == 0)
 			{
 				ss << "\n";
@@ -211,17 +399,127 @@ public:
 		return ss.str();
 	}
 private:
-	void encodeHeader(uint8* writePtr)
+	// Reads the body across the frames for parsing a message
+	class FrameInputStream : public google::protobuf::io::ZeroCopyInputStream
+	{
+	public:
+		explicit FrameInputStream(BasicPacket const& packet) :
+			m_packet(packet),
+			m_frame(0),
+			m_offset(0),
+			m_byteCount(0)
+		{
+		}
+
+		bool Next(void const** data, int* size) override
+		{
+			for (; m_frame < m_packet.getFrameCount(); ++m_frame, m_offset = 0)
+			{
+				uint32 frameBytes = m_packet.getFrameBodyBytes(m_frame);
+				if (m_offset < frameBytes)
+				{
+					*data = m_packet.getFrameBodyData(m_frame) + m_offset;
+					*size = static_cast<int>(frameBytes - m_offset);
+					m_byteCount += *size;
+					m_offset = frameBytes;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void BackUp(int count) override
+		{
+			m_offset -= count;
+			m_byteCount -= count;
+		}
+
+		bool Skip(int count) override
+		{
+			void const* data;
+			int size;
+			while (count > 0)
+			{
+				if (!this->Next(&data, &size))
+					return false;
+
+				if (size > count)
+					this->BackUp(size - count);
+				count -= size;
+			}
+
+			return true;
+		}
+
+		google::protobuf::int64 ByteCount() const override { return m_byteCount; }
+
+	private:
+		BasicPacket const& m_packet;
+		uint32 m_frame;
+		uint32 m_offset;
+		google::protobuf::int64 m_byteCount;
+	};
+
+	// Writes the body across the frames for serializing a message. The frames must have been allocated
+	class FrameOutputStream : public google::protobuf::io::ZeroCopyOutputStream
+	{
+	public:
+		explicit FrameOutputStream(BasicPacket& packet) :
+			m_packet(packet),
+			m_frame(0),
+			m_offset(0),
+			m_byteCount(0)
+		{
+		}
+
+		bool Next(void** data, int* size) override
+		{
+			for (; m_frame < m_packet.getFrameCount(); ++m_frame, m_offset = 0)
+			{
+				uint32 frameBytes = m_packet.getFrameBodyBytes(m_frame);
+				if (m_offset < frameBytes)
+				{
+					*data = m_packet.getFrameBodyPointer(m_frame) + m_offset;
+					*size = static_cast<int>(frameBytes - m_offset);
+					m_byteCount += *size;
+					m_offset = frameBytes;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void BackUp(int count) override
+		{
+			m_offset -= count;
+			m_byteCount -= count;
+		}
+
+		google::protobuf::int64 ByteCount() const override { return m_byteCount; }
+
+	private:
+		BasicPacket& m_packet;
+		uint32 m_frame;
+		uint32 m_offset;
+		google::protobuf::int64 m_byteCount;
+	};
+
+	void encodeFrameHeader(uint32 frame, uint8* writePtr) const
 	{
 		NS_ASSERT(m_opcode != INVALID_OPCODE);
 
-		uint16 bodySize = this->getBodyBytes();
+		uint32 bodySize = this->getFrameBodyBytes(frame);
+		uint16 opcode = m_opcode;
+		if (frame + 1 < this->getFrameCount())
+			opcode |= CONTINUATION_OPCODE_FLAG;
 
 		*(writePtr++) = 0xFF & (bodySize >> 8);
 		*(writePtr++) = 0xFF & bodySize;
 
-		*(writePtr++) = 0xFF & (m_opcode >> 8);
-		*(writePtr++) = 0xFF & m_opcode;
+		*(writePtr++) = 0xFF & (opcode >> 8);
+		*(writePtr++) = 0xFF & opcode;
 	}
 
 
@@ -229,44 +527,92 @@ private:
 	{
 		std::swap(m_bodySize, right.m_bodySize);
 		std::swap(m_opcode, right.m_opcode);
+		std::swap(m_isContinued, right.m_isContinued);
 		std::swap(m_bufferSize, right.m_bufferSize);
 		std::swap(m_buffer, right.m_buffer);
+		std::swap(m_borrowedBuffer, right.m_borrowedBuffer);
+		std::swap(m_borrowedBody, right.m_borrowedBody);
+		std::swap(m_frameBuffers, right.m_frameBuffers);
+		std::swap(m_sharedBody, right.m_sharedBody);
+		std::swap(m_header, right.m_header);
+		std::swap(m_frameHeaders, right.m_frameHeaders);
 		std::swap(m_timestamp, right.m_timestamp);
+		std::swap(m_isDatagram, right.m_isDatagram);
+		std::swap(m_datagramSequence, right.m_datagramSequence);
 	}
 
-	void allocBufferIfNeeded(uint16 size)
+	// Allocate the buffers of all frames of a body of the specified size
+	void allocBody(uint32 size)
 	{
-		if (m_buffer && m_bufferSize >= size)
-			return;
+		// The packet is about to own its body, it no longer references a shared or borrowed one
+		m_sharedBody.reset();
+		this->releaseBorrowedBody();
+		this->deallocFrameBuffers();
 
-		this->deallocBuffer();
+		uint32 firstBytes = std::min<uint32>(size, MAX_BODY_BYTE_SIZE);
+		if (!m_buffer || m_bufferSize < firstBytes)
+		{
+			this->deallocBuffer();
 
-		uint16 realSize = DEFAULT_BUFFER_SIZE;
-		if (size > realSize)
-			realSize = ((size + DEFAULT_BUFFER_SIZE - 1) / DEFAULT_BUFFER_SIZE) * DEFAULT_BUFFER_SIZE;
+			// The buffer is drawn from the pool, its size is rounded up to the size class
+			m_bufferSize = static_cast<uint32>(BufferPool::getBlockSize(std::max<uint32>(firstBytes, DEFAULT_BUFFER_SIZE)));
+			m_buffer = sBufferPool->allocate(m_bufferSize);
+		}
 
-		m_bufferSize = realSize;
-		m_buffer = new uint8[realSize];
+		for (uint32 offset = MAX_BODY_BYTE_SIZE; offset < size; offset += MAX_BODY_BYTE_SIZE)
+		{
+			uint32 bufferSize = static_cast<uint32>(BufferPool::getBlockSize(std::max<uint32>(std::min<uint32>(size - offset, MAX_BODY_BYTE_SIZE), DEFAULT_BUFFER_SIZE)));
+			m_frameBuffers.emplace_back(sBufferPool->allocate(bufferSize), bufferSize);
+		}
 	}
 
 	void deallocBuffer()
 	{
 		if (m_buffer)
 		{
-			delete[] m_buffer;
+			sBufferPool->deallocate(m_buffer, m_bufferSize);
 			m_buffer = nullptr;
+			m_bufferSize = 0;
 		}
+
+		this->deallocFrameBuffers();
+	}
+
+	void releaseBorrowedBody()
+	{
+		m_borrowedBuffer.reset();
+		m_borrowedBody = nullptr;
+	}
+
+	void deallocFrameBuffers()
+	{
+		for (auto const& frameBuffer : m_frameBuffers)
+			sBufferPool->deallocate(frameBuffer.first, frameBuffer.second);
+		m_frameBuffers.clear();
 	}
 
 	uint8* getBodyPointer() const { return m_buffer; }
+	uint8* getFrameBodyPointer(uint32 frame) const { return frame == 0 ? m_buffer : m_frameBuffers[frame - 1].first; }
 
-	uint16 m_bodySize;
+	uint32 m_bodySize;
 	uint16 m_opcode;
+	bool m_isContinued;
 
-	uint16 m_bufferSize;
+	uint32 m_bufferSize;
 	uint8* m_buffer;
+	// The buffers (and their sizes) of the second and following frames of the body
+	std::vector<std::pair<uint8*, uint32>> m_frameBuffers;
+	SharedPayloadPtr m_sharedBody;
+	// The receive buffer that the body is borrowed from, see borrowBody()
+	std::shared_ptr<MessageBuffer> m_borrowedBuffer;
+	uint8 const* m_borrowedBody;
+	uint8 m_header[HEADER_BYTE_SIZE];
+	// The headers of all frames if the body is split into several frames
+	std::vector<uint8> m_frameHeaders;
 
 	int64 m_timestamp;
+	bool m_isDatagram;
+	uint32 m_datagramSequence;
 };
 
 
@@ -0,0 +1,196 @@
+#include "BufferPool.h"
+
+#include "utilities/StringUtil.h"
+
+namespace
+{
+	// Set when the cache of the current thread has been destroyed. Blocks freed
+	// after that (e.g. by static destructors) are returned to the shared list directly
+	thread_local bool tThreadCacheDestroyed = false;
+}
+
+struct BufferPool::ThreadCache
+{
+	ThreadCache()
+	{
+		for (int32 i = 0; i < NUM_SIZE_CLASSES; ++i)
+			lists[i].reserve(THREAD_CACHE_CAPACITY);
+	}
+
+	~ThreadCache()
+	{
+		tThreadCacheDestroyed = true;
+		for (int32 i = 0; i < NUM_SIZE_CLASSES; ++i)
+			sBufferPool->releaseToSharedList(i, lists[i].data(), lists[i].size());
+	}
+
+	std::vector<uint8*> lists[NUM_SIZE_CLASSES];
+};
+
+BufferPool::BufferPool():
+	m_hits(0),
+	m_misses(0),
+	m_outstandingBytes(0),
+	m_sharedBytes(0)
+{
+	for (int32 i = 0; i < NUM_SIZE_CLASSES; ++i)
+		m_sharedLists[i].reserve(SHARED_LIST_CAPACITY);
+}
+
+BufferPool::~BufferPool()
+{
+	for (int32 i = 0; i < NUM_SIZE_CLASSES; ++i)
+	{
+		for (uint8* block : m_sharedLists[i])
+			delete[] block;
+		m_sharedLists[i].clear();
+	}
+}
+
+BufferPool* BufferPool::instance()
+{
+	static BufferPool instance;
+	return &instance;
+}
+
+uint8* BufferPool::allocate(std::size_t size)
+{
+	int32 sizeClass = getSizeClass(size);
+	if (sizeClass < 0)
+	{
+		m_misses.fetch_add(1, std::memory_order_relaxed);
+		m_outstandingBytes.fetch_add(size, std::memory_order_relaxed);
+		return new uint8[size];
+	}
+
+	std::size_t blockSize = static_cast<std::size_t>(MIN_BLOCK_SIZE) << sizeClass;
+	m_outstandingBytes.fetch_add(blockSize, std::memory_order_relaxed);
+
+	ThreadCache* cache = getThreadCache();
+	if (cache)
+	{
+		std::vector<uint8*>& list = cache->lists[sizeClass];
+		if (list.empty())
+			this->takeFromSharedList(sizeClass, list);
+
+		if (!list.empty())
+		{
+			uint8* block = list.back();
+			list.pop_back();
+			m_hits.fetch_add(1, std::memory_order_relaxed);
+			return block;
+		}
+	}
+
+	m_misses.fetch_add(1, std::memory_order_relaxed);
+	return new uint8[blockSize];
+}
+
+void BufferPool::deallocate(uint8* block, std::size_t size)
+{
+	if (!block)
+		return;
+
+	int32 sizeClass = getSizeClass(size);
+	if (sizeClass < 0)
+	{
+		m_outstandingBytes.fetch_sub(size, std::memory_order_relaxed);
+		delete[] block;
+		return;
+	}
+
+	std::size_t blockSize = static_cast<std::size_t>(MIN_BLOCK_SIZE) << sizeClass;
+	m_outstandingBytes.fetch_sub(blockSize, std::memory_order_relaxed);
+
+	ThreadCache* cache = getThreadCache();
+	if (!cache)
+	{
+		this->releaseToSharedList(sizeClass, &block, 1);
+		return;
+	}
+
+	// Move half of a full cache to the shared list, so that a thread that mostly frees 
+	// blocks allocated by other threads does not hold on to them
+	std::vector<uint8*>& list = cache->lists[sizeClass];
+	if (list.size() >= THREAD_CACHE_CAPACITY)
+	{
+		std::size_t count = THREAD_CACHE_CAPACITY / 2;
+		this->releaseToSharedList(sizeClass, list.data() + list.size() - count, count);
+		list.resize(list.size() - count);
+	}
+
+	list.push_back(block);
+}
+
+std::size_t BufferPool::getBlockSize(std::size_t size)
+{
+	int32 sizeClass = getSizeClass(size);
+	if (sizeClass < 0)
+		return size;
+
+	return static_cast<std::size_t>(MIN_BLOCK_SIZE) << sizeClass;
+}
+
+std::string BufferPool::description() const
+{
+	uint64 hits = this->getHits();
+	uint64 misses = this->getMisses();
+	double hitRate = hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0;
+
+	return StringUtil::format("hits: %llu, misses: %llu, hit rate: %.1f%%, outstanding bytes: %lld, shared bytes: %lld",
+		static_cast<unsigned long long>(hits), static_cast<unsigned long long>(misses), hitRate,
+		static_cast<long long>(this->getOutstandingBytes()), static_cast<long long>(this->getSharedBytes()));
+}
+
+int32 BufferPool::getSizeClass(std::size_t size)
+{
+	std::size_t blockSize = MIN_BLOCK_SIZE;
+	for (int32 i = 0; i < NUM_SIZE_CLASSES; ++i, blockSize <<= 1)
+	{
+		if (size <= blockSize)
+			return i;
+	}
+
+	return -1;
+}
+
+BufferPool::ThreadCache* BufferPool::getThreadCache()
+{
+	if (tThreadCacheDestroyed)
+		return nullptr;
+
+	static thread_local ThreadCache cache;
+	return &cache;
+}
+
+void BufferPool::takeFromSharedList(int32 sizeClass, std::vector<uint8*>& cache)
+{
+	std::lock_guard<std::mutex> lock(m_sharedLocks[sizeClass]);
+
+	std::vector<uint8*>& shared = m_sharedLists[sizeClass];
+	std::size_t count = std::min<std::size_t>(shared.size(), THREAD_CACHE_CAPACITY / 2);
+	if (count == 0)
+		return;
+
+	cache.insert(cache.end(), shared.end() - count, shared.end());
+	shared.resize(shared.size() - count);
+	m_sharedBytes.fetch_sub(static_cast<int64>(count * (static_cast<std::size_t>(MIN_BLOCK_SIZE) << sizeClass)), std::memory_order_relaxed);
+}
+
+void BufferPool::releaseToSharedList(int32 sizeClass, uint8* const* blocks, std::size_t count)
+{
+	std::size_t blockSize = static_cast<std::size_t>(MIN_BLOCK_SIZE) << sizeClass;
+	std::size_t kept = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_sharedLocks[sizeClass]);
+
+		std::vector<uint8*>& shared = m_sharedLists[sizeClass];
+		kept = std::min<std::size_t>(count, SHARED_LIST_CAPACITY - std::min<std::size_t>(shared.size(), SHARED_LIST_CAPACITY));
+		shared.insert(shared.end(), blocks, blocks + kept);
+	}
+	m_sharedBytes.fetch_add(static_cast<int64>(kept * blockSize), std::memory_order_relaxed);
+
+	// The shared list is full, the remaining blocks are released to the system
+	for (std::size_t i = kept; i < count; ++i)
+		delete[] blocks[i];
+}
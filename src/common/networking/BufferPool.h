@@ -0,0 +1,113 @@
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include <atomic>
+#include <mutex>
+
+#include "Common.h"
+
+// A size-classed pool of byte blocks used by the packet and message buffers.
+// Each thread keeps a small cache of free blocks per size class, so the common case
+// takes no lock. Blocks freed by another thread than the one that allocated them
+// go to the freeing thread's cache, and the overflow of any cache is moved to a shared list
+class BufferPool
+{
+public:
+	enum
+	{
+		// Block size of the smallest size class
+		MIN_BLOCK_SIZE = 1024,
+		// The size classes are 1K, 2K, 4K ... 64K. Larger requests bypass the pool
+		NUM_SIZE_CLASSES = 7,
+		// The maximum number of free blocks per size class kept by each thread
+		THREAD_CACHE_CAPACITY = 64,
+		// The maximum number of free blocks per size class kept in the shared list
+		SHARED_LIST_CAPACITY = 1024,
+	};
+
+	static BufferPool* instance();
+
+	// Allocate a block of at least the specified size. The function is thread-safe
+	uint8* allocate(std::size_t size);
+	// Return a block to the pool. The size must be the size that was passed
+	// to allocate() or the block size. The function is thread-safe
+	void deallocate(uint8* block, std::size_t size);
+
+	// Returns the actual size of a block allocated with the specified size
+	static std::size_t getBlockSize(std::size_t size);
+
+	uint64 getHits() const { return m_hits.load(std::memory_order_relaxed); }
+	uint64 getMisses() const { return m_misses.load(std::memory_order_relaxed); }
+	int64 getOutstandingBytes() const { return m_outstandingBytes.load(std::memory_order_relaxed); }
+	int64 getSharedBytes() const { return m_sharedBytes.load(std::memory_order_relaxed); }
+
+	std::string description() const;
+
+private:
+	struct ThreadCache;
+	friend struct ThreadCache;
+
+	BufferPool();
+	~BufferPool();
+
+	static int32 getSizeClass(std::size_t size);
+	// Returns the cache of the calling thread, or nullptr if it has already been destroyed
+	static ThreadCache* getThreadCache();
+
+	void takeFromSharedList(int32 sizeClass, std::vector<uint8*>& cache);
+	void releaseToSharedList(int32 sizeClass, uint8* const* blocks, std::size_t count);
+
+	std::mutex m_sharedLocks[NUM_SIZE_CLASSES];
+	std::vector<uint8*> m_sharedLists[NUM_SIZE_CLASSES];
+
+	std::atomic<uint64> m_hits;
+	std::atomic<uint64> m_misses;
+	std::atomic<int64> m_outstandingBytes;
+	std::atomic<int64> m_sharedBytes;
+};
+
+#define sBufferPool BufferPool::instance()
+
+// Standard allocator that draws from the BufferPool, used as the storage allocator of MessageBuffer
+template<typename T>
+class BufferPoolAllocator
+{
+public:
+	typedef T value_type;
+
+	BufferPoolAllocator() {}
+	template<typename U>
+	BufferPoolAllocator(BufferPoolAllocator<U> const&) {}
+
+	T* allocate(std::size_t n)
+	{
+		return reinterpret_cast<T*>(sBufferPool->allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t n)
+	{
+		sBufferPool->deallocate(reinterpret_cast<uint8*>(p), n * sizeof(T));
+	}
+
+	// Elements are default-initialized rather than value-initialized, so growing a buffer does not
+	// clear bytes that are about to be overwritten by a read
+	template<typename U>
+	void construct(U* p)
+	{
+		::new (static_cast<void*>(p)) U;
+	}
+
+	template<typename U, typename... Args>
+	void construct(U* p, Args&&... args)
+	{
+		::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+};
+
+template<typename T, typename U>
+inline bool operator==(BufferPoolAllocator<T> const&, BufferPoolAllocator<U> const&) { return true; }
+
+template<typename T, typename U>
+inline bool operator!=(BufferPoolAllocator<T> const&, BufferPoolAllocator<U> const&) { return false; }
+
+#endif // __BUFFER_POOL_H__
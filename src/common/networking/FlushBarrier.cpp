@@ -0,0 +1,45 @@
+#include "FlushBarrier.h"
+
+namespace
+{
+	// The barrier entered by the calling thread
+	thread_local FlushBarrier* tCurrentBarrier = nullptr;
+}
+
+FlushBarrier::FlushBarrier()
+{
+}
+
+void FlushBarrier::enter()
+{
+	tCurrentBarrier = this;
+}
+
+void FlushBarrier::leave()
+{
+	tCurrentBarrier = nullptr;
+}
+
+FlushBarrier* FlushBarrier::getCurrent()
+{
+	return tCurrentBarrier;
+}
+
+void FlushBarrier::defer(std::function<void()>&& flush)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_flushes.push_back(std::move(flush));
+}
+
+void FlushBarrier::release()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_releasingFlushes.swap(m_flushes);
+	}
+
+	// A flush only posts to the network thread of its socket
+	for (auto& flush : m_releasingFlushes)
+		flush();
+	m_releasingFlushes.clear();
+}
@@ -0,0 +1,38 @@
+#ifndef __FLUSH_BARRIER_H__
+#define __FLUSH_BARRIER_H__
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "Common.h"
+
+// Defers the flushes of the sockets that queue packets during a tick until the tick has ended,
+// so the packets a socket is sent during one tick are written together by a single flush.
+// A thread enters the barrier before it runs its part of the tick and leaves it afterwards.
+// A socket that queues a packet in between registers its flush with the barrier instead of
+// posting it to its network thread, and release() posts the flushes once the tick has ended
+class FlushBarrier
+{
+public:
+	FlushBarrier();
+
+	void enter();
+	void leave();
+
+	// Returns the barrier the calling thread has entered, or nullptr
+	static FlushBarrier* getCurrent();
+
+	// Called by a socket the first time a packet is queued for it during the tick. The function is thread-safe
+	void defer(std::function<void()>&& flush);
+
+	// Run the deferred flushes. Called after all threads of the tick have left the barrier
+	void release();
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::function<void()>> m_flushes;
+	std::vector<std::function<void()>> m_releasingFlushes;
+};
+
+#endif // __FLUSH_BARRIER_H__
@@ -6,6 +6,7 @@
 #include <cstring>
 
 #include "Common.h"
+#include "BufferPool.h"
 
 
 class MessageBuffer
@@ -19,7 +20,7 @@ public:
 
 	}
 
-	explicit MessageBuffer(uint16 bufferSize) :
+	explicit MessageBuffer(uint32 bufferSize) :
 		m_rpos(0),
 		m_wpos(0),
 		m_timestamp(0)
@@ -70,12 +71,12 @@ public:
 	uint8* getReadPointer() { return getBasePointer() + m_rpos; }
 	uint8* getWritePointer() { return getBasePointer() + m_wpos; }
 
-	void readCompleted(uint16 bytes) { m_rpos += bytes; }
-	void writeCompleted(uint16 bytes) { m_wpos += bytes; }
+	void readCompleted(uint32 bytes) { m_rpos += bytes; }
+	void writeCompleted(uint32 bytes) { m_wpos += bytes; }
 
-	uint16 getActiveSize() const { return m_wpos - m_rpos; }
-	uint16 getRemainingSpace() const { return static_cast<uint16>(m_storage.size() - m_wpos); }
-	uint16 getBufferSize() const { return static_cast<uint16>(m_storage.size()); }
+	uint32 getActiveSize() const { return m_wpos - m_rpos; }
+	uint32 getRemainingSpace() const { return static_cast<uint32>(m_storage.size() - m_wpos); }
+	uint32 getBufferSize() const { return static_cast<uint32>(m_storage.size()); }
 
 	void reset()
 	{
@@ -83,7 +84,7 @@ public:
 		m_rpos = 0;
 	}
 
-	void resize(uint16 newSize)
+	void resize(uint32 newSize)
 	{
 		m_storage.resize(newSize);
 	}
@@ -101,7 +102,7 @@ public:
 	}
 
 	// Ensure that the free space is enough to store the expected data size
-	void ensureFreeSpace(uint16 expectSize)
+	void ensureFreeSpace(uint32 expectSize)
 	{
 		this->normalize();
 		if (getRemainingSpace() < expectSize)
@@ -131,9 +132,9 @@ private:
 		std::swap(m_timestamp, right.m_timestamp);
 	}
 
-	uint16 m_rpos;
-	uint16 m_wpos;
-	std::vector<uint8> m_storage;
+	uint32 m_rpos;
+	uint32 m_wpos;
+	std::vector<uint8, BufferPoolAllocator<uint8> > m_storage;
 
 	int64 m_timestamp;
 };
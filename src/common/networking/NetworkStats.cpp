@@ -0,0 +1,70 @@
+#include "NetworkStats.h"
+
+#include "utilities/StringUtil.h"
+
+NetworkStats::NetworkStats():
+	m_acceptCount(0),
+	m_shedPerIpCount(0),
+	m_shedGlobalCount(0),
+	m_writeCount(0),
+	m_writePackets(0),
+	m_writeBytes(0),
+	m_droppedPackets(0),
+	m_compressedPackets(0),
+	m_compressionInBytes(0),
+	m_compressionOutBytes(0)
+{
+	for (int32 i = 0; i < MAX_SEND_LANES; ++i)
+		m_queuedBytes[i] = 0;
+}
+
+NetworkStats::~NetworkStats()
+{
+}
+
+NetworkStats* NetworkStats::instance()
+{
+	static NetworkStats instance;
+	return &instance;
+}
+
+void NetworkStats::reset()
+{
+	m_acceptCount = 0;
+	m_shedPerIpCount = 0;
+	m_shedGlobalCount = 0;
+	m_writeCount = 0;
+	m_writePackets = 0;
+	m_writeBytes = 0;
+	m_droppedPackets = 0;
+	m_compressedPackets = 0;
+	m_compressionInBytes = 0;
+	m_compressionOutBytes = 0;
+	m_sendLatency.reset();
+}
+
+std::string NetworkStats::description() const
+{
+	uint64 writes = this->getWriteCount();
+	uint64 packets = this->getWritePackets();
+	uint64 bytes = this->getWriteBytes();
+	double packetsPerWrite = writes > 0 ? static_cast<double>(packets) / writes : 0.0;
+	double bytesPerWrite = writes > 0 ? static_cast<double>(bytes) / writes : 0.0;
+	Histogram sendLatency;
+	this->getSendLatency(sendLatency);
+
+	return StringUtil::format("accepts: %llu, shed per ip: %llu, shed global: %llu, writes: %llu, packets: %llu, bytes: %llu, packets/write: %.2f, bytes/write: %.1f, send latency p50: %lluus, p99: %lluus, max: %lluus, "
+		"queued bytes reliable: %lld, droppable: %lld, dropped packets: %llu, "
+		"compressed packets: %llu, compressed bytes: %llu -> %llu",
+		static_cast<unsigned long long>(this->getAcceptCount()),
+		static_cast<unsigned long long>(this->getShedPerIpCount()), static_cast<unsigned long long>(this->getShedGlobalCount()),
+		static_cast<unsigned long long>(writes), static_cast<unsigned long long>(packets), static_cast<unsigned long long>(bytes),
+		packetsPerWrite, bytesPerWrite,
+		static_cast<unsigned long long>(sendLatency.getPercentile(50)), static_cast<unsigned long long>(sendLatency.getPercentile(99)),
+		static_cast<unsigned long long>(sendLatency.getMax()),
+		static_cast<long long>(this->getQueuedBytes(SEND_LANE_RELIABLE)), static_cast<long long>(this->getQueuedBytes(SEND_LANE_DROPPABLE)),
+		static_cast<unsigned long long>(this->getDroppedPackets()),
+		static_cast<unsigned long long>(m_compressedPackets.load(std::memory_order_relaxed)),
+		static_cast<unsigned long long>(m_compressionInBytes.load(std::memory_order_relaxed)),
+		static_cast<unsigned long long>(m_compressionOutBytes.load(std::memory_order_relaxed)));
+}
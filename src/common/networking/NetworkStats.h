@@ -0,0 +1,89 @@
+#ifndef __NETWORK_STATS_H__
+#define __NETWORK_STATS_H__
+
+#include <atomic>
+
+#include "Common.h"
+#include "utilities/ShardedHistogram.h"
+#include "SendLane.h"
+#include "AdmissionControl.h"
+
+// Process-wide network counters. The counters are updated by the network threads
+// and can be read from any thread
+class NetworkStats
+{
+public:
+	static NetworkStats* instance();
+
+	// Called when an asynchronous write has completed.
+	// The packets and bytes are the amount of data handed to the write
+	void addWrite(uint32 packets, uint32 bytes)
+	{
+		m_writeCount.fetch_add(1, std::memory_order_relaxed);
+		m_writePackets.fetch_add(packets, std::memory_order_relaxed);
+		m_writeBytes.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	// Called when an acceptor has accepted a new connection
+	void addAccept() { m_acceptCount.fetch_add(1, std::memory_order_relaxed); }
+	uint64 getAcceptCount() const { return m_acceptCount.load(std::memory_order_relaxed); }
+
+	// Called when an acceptor closes a new connection because of the admission control
+	void addShedConnection(AdmissionResult reason)
+	{
+		if (reason == ADMISSION_SHED_PER_IP)
+			m_shedPerIpCount.fetch_add(1, std::memory_order_relaxed);
+		else
+			m_shedGlobalCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	uint64 getShedPerIpCount() const { return m_shedPerIpCount.load(std::memory_order_relaxed); }
+	uint64 getShedGlobalCount() const { return m_shedGlobalCount.load(std::memory_order_relaxed); }
+
+	// Bytes waiting in the send queues of all sockets, per lane
+	void addQueuedBytes(int32 lane, int64 bytes) { m_queuedBytes[lane].fetch_add(bytes, std::memory_order_relaxed); }
+	int64 getQueuedBytes(int32 lane) const { return m_queuedBytes[lane].load(std::memory_order_relaxed); }
+
+	// Called when a droppable packet is dropped because the send queue is full
+	void addDroppedPacket() { m_droppedPackets.fetch_add(1, std::memory_order_relaxed); }
+	uint64 getDroppedPackets() const { return m_droppedPackets.load(std::memory_order_relaxed); }
+
+	// Called when a packet body has been compressed
+	void addCompressed(uint32 originalBytes, uint32 compressedBytes)
+	{
+		m_compressedPackets.fetch_add(1, std::memory_order_relaxed);
+		m_compressionInBytes.fetch_add(originalBytes, std::memory_order_relaxed);
+		m_compressionOutBytes.fetch_add(compressedBytes, std::memory_order_relaxed);
+	}
+
+	// Time (in microseconds) from queuing a packet to the completion of the write that sent it
+	void addSendLatency(int64 micros) { m_sendLatency.add(micros); }
+	void getSendLatency(Histogram& result) const { m_sendLatency.collect(result); }
+
+	uint64 getWriteCount() const { return m_writeCount.load(std::memory_order_relaxed); }
+	uint64 getWritePackets() const { return m_writePackets.load(std::memory_order_relaxed); }
+	uint64 getWriteBytes() const { return m_writeBytes.load(std::memory_order_relaxed); }
+
+	void reset();
+	std::string description() const;
+
+private:
+	NetworkStats();
+	~NetworkStats();
+
+	std::atomic<uint64> m_acceptCount;
+	std::atomic<uint64> m_shedPerIpCount;
+	std::atomic<uint64> m_shedGlobalCount;
+	std::atomic<uint64> m_writeCount;
+	std::atomic<uint64> m_writePackets;
+	std::atomic<uint64> m_writeBytes;
+	std::atomic<int64> m_queuedBytes[MAX_SEND_LANES];
+	std::atomic<uint64> m_droppedPackets;
+	std::atomic<uint64> m_compressedPackets;
+	std::atomic<uint64> m_compressionInBytes;
+	std::atomic<uint64> m_compressionOutBytes;
+	ShardedHistogram m_sendLatency;
+};
+
+#define sNetworkStats NetworkStats::instance()
+
+#endif // __NETWORK_STATS_H__
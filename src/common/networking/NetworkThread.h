@@ -13,12 +13,30 @@
 #include "utilities/Util.h"
 #include "debugging/Errors.h"
 #include "logging/Log.h"
-#include "containers/ConcurrentQueue.h"
+#include "containers/MPSCQueue.h"
+#include "threading/ThreadAffinity.h"
+#include "utilities/TimeUtil.h"
 
 #define UPDATE_TIMER_INTERVAL				10 // Milliseconds
+// Update interval when sockets are flushed by events, the update only does housekeeping
+#define HOUSEKEEPING_TIMER_INTERVAL			100 // Milliseconds
 
 using boost::asio::ip::tcp;
 
+// The event demultiplexer used by the io_service of the network threads
+inline char const* getNetworkBackendName()
+{
+#if defined(BOOST_ASIO_HAS_IOCP)
+	return "iocp";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+	return "epoll";
+#elif defined(BOOST_ASIO_HAS_KQUEUE)
+	return "kqueue";
+#else
+	return "select";
+#endif
+}
+
 template<class SOCKET_TYPE>
 class NetworkThread
 {
@@ -26,6 +44,9 @@ public:
     NetworkThread() : 
 		m_connections(0), 
 		m_isStopped(false), 
+		m_updateInterval(UPDATE_TIMER_INTERVAL),
+		m_threadIndex(0),
+		m_spinTime(0),
 		m_thread(nullptr),
         m_acceptSocket(m_ioService),
 		m_updateTimer(m_ioService)
@@ -66,10 +87,25 @@ public:
     {
 		++m_connections;
 		m_pendingSockets.add(socket);
+
+		// Start the socket right away instead of waiting for the next update
+		if (m_updateInterval > UPDATE_TIMER_INTERVAL)
+			m_ioService.post(std::bind(&NetworkThread<SOCKET_TYPE>::processPendingSockets, this));
     }
 
+	// Set the interval of the periodic update. Must be called before start()
+	void setUpdateInterval(int32 interval) { m_updateInterval = interval; }
+	int32 getUpdateInterval() const { return m_updateInterval; }
+
+	// The index selects the core from Network.Threads.Cores. Must be called before start()
+	void setThreadIndex(uint32 index) { m_threadIndex = index; }
+	// Time (in microseconds) to keep polling for events before blocking, 0 blocks right away. 
+	// Spinning avoids the wake-up latency of a blocked thread at the cost of a busy core. Must be called before start()
+	void setSpinTime(int32 micros) { m_spinTime = micros; }
+
 	int32 getConnectionCount() const { return m_connections; }
     tcp::socket* getSocketForAccept() { return &m_acceptSocket; }
+	boost::asio::io_service& getIoService() { return m_ioService; }
 
 protected:
     virtual void onSocketAdded(std::shared_ptr<SOCKET_TYPE> socket) { }
@@ -100,9 +136,14 @@ private:
     {
         NS_LOG_INFO("network.thread", "Network Thread(ID=%s) starting.", getCurrentThreadId().c_str());
 
+		pinCurrentThread("Network.Threads.Cores", m_threadIndex, "network.thread");
+
 		this->scheduleUpdateTimer();
 
-        m_ioService.run();
+		if (m_spinTime > 0)
+			this->runWithSpin();
+		else
+			m_ioService.run();
 
         m_pendingSockets.clear();
         m_sockets.clear();
@@ -110,10 +151,33 @@ private:
 		NS_LOG_INFO("network.thread", "Network Thread(ID=%s) exited.", getCurrentThreadId().c_str());
     }
 
+	void runWithSpin()
+	{
+		int64 idleSince = getSteadyTimeMicros();
+		while (!m_ioService.stopped())
+		{
+			if (m_ioService.poll() > 0)
+			{
+				idleSince = getSteadyTimeMicros();
+				continue;
+			}
+
+			if (getSteadyTimeMicros() - idleSince < m_spinTime)
+			{
+				cpuRelax();
+				continue;
+			}
+
+			// Block until the next event, the update timer is always pending
+			m_ioService.run_one();
+			idleSince = getSteadyTimeMicros();
+		}
+	}
+
 	void scheduleUpdateTimer()
 	{
 		boost::system::error_code ec;
-		m_updateTimer.expires_from_now(boost::posix_time::milliseconds(UPDATE_TIMER_INTERVAL), ec);
+		m_updateTimer.expires_from_now(boost::posix_time::milliseconds(m_updateInterval), ec);
 		if (!ec)
 			m_updateTimer.async_wait(std::bind(&NetworkThread<SOCKET_TYPE>::update, this, std::placeholders::_1));
 		else
@@ -156,12 +220,15 @@ private:
 
     std::atomic<int32> m_connections;
     std::atomic<bool> m_isStopped;
+	int32 m_updateInterval;
+	uint32 m_threadIndex;
+	int32 m_spinTime;
 
     std::thread* m_thread;
 
     SocketContainer m_sockets;
 
-	ConcurrentQueue<std::shared_ptr<SOCKET_TYPE>> m_pendingSockets;
+	MPSCQueue<std::shared_ptr<SOCKET_TYPE>> m_pendingSockets;
 
     boost::asio::io_service m_ioService;
     tcp::socket m_acceptSocket;
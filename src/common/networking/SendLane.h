@@ -0,0 +1,16 @@
+#ifndef __SEND_LANE_H__
+#define __SEND_LANE_H__
+
+// Priority lanes of the socket send queue.
+// When the send queue exceeds its limit, queued packets in the droppable lane are dropped 
+// (oldest first) before the connection is closed. Packets keep their order across lanes
+enum SendLane
+{
+	// Packets that must be delivered, such as game state changes
+	SEND_LANE_RELIABLE,
+	// Packets that are superseded by later packets, such as movement heartbeats
+	SEND_LANE_DROPPABLE,
+	MAX_SEND_LANES
+};
+
+#endif // __SEND_LANE_H__
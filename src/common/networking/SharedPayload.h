@@ -0,0 +1,52 @@
+#ifndef __SHARED_PAYLOAD_H__
+#define __SHARED_PAYLOAD_H__
+
+#include <memory>
+
+#include <google/protobuf/message_lite.h>
+
+#include "Common.h"
+#include "BufferPool.h"
+
+using google::protobuf::MessageLite;
+
+class SharedPayload;
+typedef std::shared_ptr<SharedPayload const> SharedPayloadPtr;
+
+// Immutable serialized message body that can be referenced by many packets.
+// A message broadcast to many sockets is serialized once, and each packet references the 
+// same body until the last of them has been written. The reference count is thread-safe
+class SharedPayload
+{
+public:
+	explicit SharedPayload(MessageLite const& message) :
+		m_size(static_cast<uint32>(message.ByteSizeLong())),
+		m_bufferSize(BufferPool::getBlockSize(m_size)),
+		m_data(sBufferPool->allocate(m_bufferSize))
+	{
+		message.SerializeWithCachedSizesToArray(m_data);
+	}
+
+	~SharedPayload()
+	{
+		sBufferPool->deallocate(m_data, m_bufferSize);
+	}
+
+	SharedPayload(SharedPayload const& right) = delete;
+	SharedPayload& operator=(SharedPayload const& right) = delete;
+
+	static SharedPayloadPtr create(MessageLite const& message)
+	{
+		return std::make_shared<SharedPayload>(message);
+	}
+
+	uint8 const* getData() const { return m_data; }
+	uint32 getSize() const { return m_size; }
+
+private:
+	uint32 m_size;
+	std::size_t m_bufferSize;
+	uint8* m_data;
+};
+
+#endif // __SHARED_PAYLOAD_H__
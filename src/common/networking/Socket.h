@@ -3,16 +3,21 @@
 
 
 #include <atomic>
+#include <deque>
 
 #include <boost/asio.hpp>
 
 #include "Common.h"
 #include "utilities/Util.h"
+#include "utilities/TimeUtil.h"
 #include "logging/Log.h"
 #include "debugging/Errors.h"
-#include "containers/ConcurrentQueue.h"
+#include "containers/MPSCQueue.h"
 #include "MessageBuffer.h"
 #include "BasicPacket.h"
+#include "NetworkStats.h"
+#include "SendLane.h"
+#include "FlushBarrier.h"
 
 using boost::asio::ip::tcp;
 
@@ -24,18 +29,36 @@ public:
 	{
 		// The default size of the message buffer
 		MESSAGE_BUFFER_SIZE = 4096,
+		// The size of the receive buffer in streaming read mode, it can hold several maximum sized packets
+		STREAM_READ_BUFFER_SIZE = 16384,
 		// Unlimited send queue size
-		SEND_QUEUE_UNLIMITED = 0
-
+		SEND_QUEUE_UNLIMITED = 0,
+		// The maximum number of packets handed to a single write.
+		// Each frame of a packet takes two buffers (header and body), which keeps the gather list under IOV_MAX
+		MAX_WRITE_BATCH_PACKETS = 64,
+		// The maximum number of bytes handed to a single write
+		MAX_WRITE_BATCH_BYTES = 65535,
+		// The maximum number of replaced receive buffers kept for reuse while packets still borrow from them
+		MAX_SPARE_READ_BUFFERS = 2
 	};
 
 	// Construct a Socket object of the specified type
 	// The readBufferSize is used to set the size of the receive buffer in user space
     Socket(tcp::socket&& socket) try:
-		m_readBuffer(MESSAGE_BUFFER_SIZE),
+		m_readBuffer(std::make_shared<MessageBuffer>(MESSAGE_BUFFER_SIZE)),
 		m_sendQueueLimit(SEND_QUEUE_UNLIMITED),
+		m_sendQueueHardLimit(SEND_QUEUE_UNLIMITED),
 		m_writeQueueSize(0),
+		m_laneBytes(),
+		m_writingCount(0),
+		m_writingPackets(0),
+		m_writingBytes(0),
+		m_isGatherWrite(true),
 		m_isWritingAsync(false),
+		m_isEventDrivenFlush(true),
+		m_isFlushPending(false),
+		m_isStreamingRead(true),
+		m_isZeroCopyRead(true),
 		m_isClosed(false),
 		m_socket(std::move(socket)),
 		m_remoteEndpoint(m_socket.remote_endpoint())
@@ -48,6 +71,9 @@ public:
 
 	virtual ~Socket() 
 	{
+		for (int32 lane = 0; lane < MAX_SEND_LANES; ++lane)
+			sNetworkStats->addQueuedBytes(lane, -m_laneBytes[lane]);
+
 		m_isClosed = true;
 		boost::system::error_code error;
 		m_socket.close(error);
@@ -58,8 +84,23 @@ public:
 		}
 	}
 
+	// When the send queue exceeds the limit, droppable packets are dropped to make room.
+	// If that is not enough, new droppable packets are discarded and reliable packets are 
+	// still queued until the hard limit is reached, at which point the socket is closed
 	void setSendQueueLimit(int32 size) { m_sendQueueLimit = size; }
 	int32 getSendQueueLimit() const { return m_sendQueueLimit; }
+	void setSendQueueHardLimit(int32 size) { m_sendQueueHardLimit = size; }
+	int32 getSendQueueHardLimit() const { return m_sendQueueHardLimit; }
+
+	// If gather write is enabled, the header and body of each queued packet are passed to a 
+	// single write as separate buffers. Otherwise they are copied into one contiguous buffer first
+	void setGatherWrite(bool enabled) { m_isGatherWrite = enabled; }
+	bool isGatherWrite() const { return m_isGatherWrite; }
+
+	// If event-driven flush is enabled, queuing a packet into an empty send queue posts a flush
+	// to the network thread of the socket. Otherwise the queue is flushed by the periodic update()
+	void setEventDrivenFlush(bool enabled) { m_isEventDrivenFlush = enabled; }
+	bool isEventDrivenFlush() const { return m_isEventDrivenFlush; }
 
 	tcp::endpoint const& getRemoteEndpoint() const { return m_remoteEndpoint;  }
 	boost::asio::ip::address getRemoteAddress() const { return m_remoteEndpoint.address(); }
@@ -68,7 +109,28 @@ public:
 	// Returns the open status of the socket. The function is thread-safe
 	bool isOpen() { return !m_isClosed; }
 
-	void asyncRead() { this->readHeader(); }
+	// In streaming read mode, the socket reads as much data as is available into the receive buffer 
+	// and delivers all complete packets in it at once with onReceivedPackets().
+	// Otherwise each packet is read with one read for the header and one for the body
+	void setStreamingRead(bool enabled) { m_isStreamingRead = enabled; }
+	bool isStreamingRead() const { return m_isStreamingRead; }
+
+	// If zero-copy read is enabled, a received packet that fits in a frame borrows its body from the
+	// receive buffer instead of copying it, see BasicPacket::borrowBody(). The receive buffer is replaced 
+	// with a new one when it is reused while packets still reference it
+	void setZeroCopyRead(bool enabled) { m_isZeroCopyRead = enabled; }
+	bool isZeroCopyRead() const { return m_isZeroCopyRead; }
+
+	void asyncRead()
+	{
+		if (m_isStreamingRead)
+		{
+			m_readBuffer->resize(STREAM_READ_BUFFER_SIZE);
+			this->readSome();
+		}
+		else
+			this->readHeader();
+	}
 
 	// Actively closes the socket. The function is thread-safe
 	void closeSocket()
@@ -89,12 +151,29 @@ public:
 
 
 	// Add data packet to queue. Function is thread-safe.
+	// If the calling thread has entered a FlushBarrier, the queue is flushed when the barrier is released.
+	// The send latency is measured from the timestamp of the packet, which is set here if the caller has not set it
 	void queuePacket(PACKET_TYPE&& packet)
 	{
 		if (m_isClosed)
 			return;
 
+		if (packet.getTimestamp() == 0)
+			packet.setTimestamp(getSteadyTimeMicros());
 		m_packetQueue.add(std::move(packet));
+
+		// Only the first packet after a flush posts a new one
+		FlushBarrier* barrier = FlushBarrier::getCurrent();
+		if ((m_isEventDrivenFlush || barrier) && !m_isFlushPending.exchange(true))
+		{
+			if (barrier)
+			{
+				auto self(this->shared_from_this());
+				barrier->defer([self]() { self->postFlush(); });
+			}
+			else
+				this->postFlush();
+		}
 	}
 
 	// Called after the socket is added to the network thread queue
@@ -103,70 +182,157 @@ public:
 	// Called when the socket receives data
 	virtual void onReceivedData(PACKET_TYPE&& packet) { }
 
+	// Called in streaming read mode with all packets parsed from one read, in the order they were received.
+	// The packets may be moved from. By default each packet is passed to onReceivedData()
+	virtual void onReceivedPackets(std::vector<PACKET_TYPE>& packets)
+	{
+		for (PACKET_TYPE& packet : packets)
+			this->onReceivedData(std::move(packet));
+	}
+
+	// Returns the send lane of an outgoing packet. Called in the network thread
+	virtual SendLane getSendLane(PACKET_TYPE const& packet) const { return SEND_LANE_RELIABLE; }
+
+	// Called in the network thread before an outgoing packet is added to the write queue.
+	// The socket may replace the body with a compressed one
+	virtual void compressPacket(PACKET_TYPE& packet) { }
+
+	// Called in the network thread when the write that sent the packet has completed.
+	// The latency (in microseconds) is measured from the timestamp of the packet
+	virtual void onPacketWritten(PACKET_TYPE const& packet, int64 latency) { }
+
 	// Called when the socket is closed
 	// This function may be called in a non-network thread, which is related to the location where the closeSocket() function is called
 	virtual void onSocketClosed() { }
 
+	// Called periodically by the network thread for housekeeping.
+	// Packets that have not been flushed by an event yet are flushed here, 
+	// unless a flush is pending, which keeps the packets of a tick together
 	virtual void update()
+	{
+		if (!m_isFlushPending)
+			this->flushPacketQueue();
+	}
+
+protected:
+	void flushPacketQueue()
 	{
 		if (m_packetQueue.empty())
 			return;
 
-		MessageBuffer buff(MESSAGE_BUFFER_SIZE);
-		PACKET_TYPE packet;
+		m_packetQueue.drain([this](PACKET_TYPE& packet)
+		{
+			if (!m_isClosed)
+				this->addToWriteQueue(std::move(packet));
+		});
 
-		// Merge data packets into a single MessageBuffer as much as possible before sending
-		while (m_packetQueue.next(packet))
+		// All packets queued since the last update are flushed with as few writes as possible
+		this->processWriteQueue();
+	}
+
+private:
+	void postFlush()
+	{
+		auto self(this->shared_from_this());
+		auto handler = [this, self]()
 		{
-			if (m_isClosed)
-				return;
+			m_isFlushPending = false;
+			if (!m_isClosed)
+				this->flushPacketQueue();
+		};
+#if BOOST_VERSION >= 106600
+		boost::asio::post(m_socket.get_executor(), handler);
+#else
+		m_socket.get_io_service().post(handler);
+#endif
+	}
 
-			if (buff.getRemainingSpace() < packet.getByteSize() 
-				&& buff.getActiveSize() > 0)
+	void readSome()
+	{
+		this->reclaimReadBuffer();
+		m_readBuffer->normalize();
+		auto self(this->shared_from_this());
+		m_socket.async_read_some(boost::asio::buffer(m_readBuffer->getWritePointer(), m_readBuffer->getRemainingSpace()),
+			[this, self](boost::system::error_code const& error, std::size_t bytes_transferred)
+		{
+			if (!error)
 			{
-				addToWriteQueue(std::move(buff));
-				buff.resize(MESSAGE_BUFFER_SIZE);
-			}
+				m_readBuffer->writeCompleted(static_cast<uint32>(bytes_transferred));
+				m_readBuffer->setTimestamp(getSteadyTimeMicros());
+				bool isValid = this->parseReadBuffer();
 
-			if (buff.getRemainingSpace() >= packet.getByteSize())
-			{
-				packet.write(buff);
+				if (!m_readBatch.empty())
+				{
+					this->onReceivedPackets(m_readBatch);
+					m_readBatch.clear();
+				}
+
+				if (isValid)
+					this->readSome();
 			}
-			// A single packet is larger than SEND_BUFFER_SIZE
 			else
 			{
-				MessageBuffer largeBuf(packet.getByteSize());
-				packet.write(largeBuf);
-				addToWriteQueue(std::move(largeBuf));
+				this->closeSocket();
+				std::string emsg = getUtf8ErrorMsg(error);
+				NS_LOG_DEBUG("network.socket", "Read data failed. address: %s:%d msg(%d): %s", this->getRemoteAddress().to_string().c_str(), this->getRemotePort(), error.value(), emsg.c_str());
+			}
+		});
+	}
+
+	// Parse all complete packets in the receive buffer into the read batch.
+	// An incomplete packet is left in the buffer until more data is received
+	bool parseReadBuffer()
+	{
+		try
+		{
+			while (m_readBuffer->getActiveSize() >= PACKET_TYPE::HEADER_BYTE_SIZE)
+			{
+				// An invalid body length is rejected by decodeHeader()
+				uint16 bodyBytes = PACKET_TYPE::peekBodyBytes(m_readBuffer->getReadPointer());
+				if (bodyBytes <= PACKET_TYPE::MAX_BODY_BYTE_SIZE 
+					&& m_readBuffer->getActiveSize() < PACKET_TYPE::HEADER_BYTE_SIZE + bodyBytes)
+					break;
+
+				PACKET_TYPE packet;
+				packet.decodeHeader(*m_readBuffer);
+				this->readPacketBody(packet);
+				if (this->assembleFrame(packet))
+					m_readBatch.push_back(std::move(packet));
 			}
 		}
-		if (buff.getActiveSize() > 0)
+		catch (PacketException const& ex)
 		{
-			addToWriteQueue(std::move(buff));
+			this->closeSocket();
+			NS_LOG_ERROR("network.socket", "Decode header of packet failed from %s:%d msg: %s", this->getRemoteAddress().to_string().c_str(), this->getRemotePort(), ex.what());
+			return false;
 		}
+
+		return true;
 	}
 
-private:
 	void readHeader()
 	{
-		m_readBuffer.reset();
+		this->reclaimReadBuffer();
+		m_readBuffer->reset();
 		auto self(this->shared_from_this());
-		boost::asio::async_read(m_socket, boost::asio::buffer(m_readBuffer.getWritePointer(), PACKET_TYPE::HEADER_BYTE_SIZE),
+		boost::asio::async_read(m_socket, boost::asio::buffer(m_readBuffer->getWritePointer(), PACKET_TYPE::HEADER_BYTE_SIZE),
 			[this, self](boost::system::error_code const& error, std::size_t bytes_transferred)
 		{
 			if (!error)
 			{
 				NS_ASSERT(bytes_transferred == PACKET_TYPE::HEADER_BYTE_SIZE);
 
-				m_readBuffer.writeCompleted(static_cast<uint16>(bytes_transferred));
+				m_readBuffer->writeCompleted(static_cast<uint32>(bytes_transferred));
+				m_readBuffer->setTimestamp(getSteadyTimeMicros());
 				try 
 				{
-					m_readPacket.decodeHeader(m_readBuffer);
+					m_readPacket.decodeHeader(*m_readBuffer);
 					if (m_readPacket.hasBody())
 						this->readBody();
 					else
 					{
-						this->onReceivedData(std::move(m_readPacket));
+						if (this->assembleFrame(m_readPacket))
+							this->onReceivedData(std::move(m_readPacket));
 						this->readHeader();
 					}
 				}
@@ -188,18 +354,30 @@ private:
 
 	void readBody()
 	{
-		m_readBuffer.ensureFreeSpace(m_readPacket.getBodyBytes());
+		this->reclaimReadBuffer();
+		m_readBuffer->ensureFreeSpace(m_readPacket.getBodyBytes());
 		auto self(this->shared_from_this());
-		boost::asio::async_read(m_socket, boost::asio::buffer(m_readBuffer.getWritePointer(), m_readPacket.getBodyBytes()),
+		boost::asio::async_read(m_socket, boost::asio::buffer(m_readBuffer->getWritePointer(), m_readPacket.getBodyBytes()),
 			[this, self](boost::system::error_code const& error, std::size_t bytes_transferred)
 		{
 			if (!error)
 			{
 				NS_ASSERT(bytes_transferred == m_readPacket.getBodyBytes());
 
-				m_readBuffer.writeCompleted(static_cast<uint16>(bytes_transferred));
-				m_readPacket.readBody(m_readBuffer);
-				this->onReceivedData(std::move(m_readPacket));
+				m_readBuffer->writeCompleted(static_cast<uint32>(bytes_transferred));
+				m_readBuffer->setTimestamp(getSteadyTimeMicros());
+				this->readPacketBody(m_readPacket);
+				try
+				{
+					if (this->assembleFrame(m_readPacket))
+						this->onReceivedData(std::move(m_readPacket));
+				}
+				catch (PacketException const& ex)
+				{
+					this->closeSocket();
+					NS_LOG_ERROR("network.socket", "Decode packet failed from %s:%d msg: %s", this->getRemoteAddress().to_string().c_str(), this->getRemotePort(), ex.what());
+					return;
+				}
 
 				this->readHeader();
 			}
@@ -213,20 +391,148 @@ private:
 		});
 	}
 
-	void addToWriteQueue(MessageBuffer&& buff)
+	// Read the body of a decoded frame from the receive buffer
+	void readPacketBody(PACKET_TYPE& packet)
 	{
-		if (m_sendQueueLimit != SEND_QUEUE_UNLIMITED && m_writeQueueSize >= m_sendQueueLimit)
+		// The frames of a streamed packet are collected in their own buffers, see assembleFrame()
+		if (m_isZeroCopyRead && !packet.isContinued() && m_streamPacket.getOpcode() == PACKET_TYPE::INVALID_OPCODE)
+			packet.borrowBody(m_readBuffer);
+		else
+			packet.readBody(*m_readBuffer);
+	}
+
+	// Called before the receive buffer is reused. If packets still borrow their bodies from it, it is replaced 
+	// with a buffer of the same size that holds the unread data. The replacement is a spare buffer whose packets 
+	// have all been handled if there is one, otherwise a new buffer
+	void reclaimReadBuffer()
+	{
+		if (m_readBuffer.use_count() == 1)
 		{
-			NS_LOG_WARN("network.socket", "Send queue is full (%d >= %d bytes). address: %s:%d", m_writeQueueSize, m_sendQueueLimit, this->getRemoteAddress().to_string().c_str(), this->getRemotePort());
-			this->closeSocket();
+			// Pairs with the release of the last reference by the thread that handled the packets
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return;
 		}
-		else
+
+		std::shared_ptr<MessageBuffer> buffer;
+		for (auto it = m_spareReadBuffers.begin(); it != m_spareReadBuffers.end(); ++it)
+		{
+			if ((*it).use_count() == 1 && (*it)->getBufferSize() == m_readBuffer->getBufferSize())
+			{
+				std::atomic_thread_fence(std::memory_order_acquire);
+				buffer = std::move(*it);
+				m_spareReadBuffers.erase(it);
+				buffer->reset();
+				break;
+			}
+		}
+
+		if (!buffer)
+			buffer = std::make_shared<MessageBuffer>(m_readBuffer->getBufferSize());
+
+		uint32 activeSize = m_readBuffer->getActiveSize();
+		if (activeSize > 0)
+		{
+			std::memcpy(buffer->getWritePointer(), m_readBuffer->getReadPointer(), activeSize);
+			buffer->writeCompleted(activeSize);
+		}
+
+		// The replaced buffer is released by the last of its packets unless it is kept as a spare
+		if (m_spareReadBuffers.size() < MAX_SPARE_READ_BUFFERS)
+			m_spareReadBuffers.push_back(std::move(m_readBuffer));
+
+		m_readBuffer = std::move(buffer);
+	}
+
+	// Collect the frames of a packet streamed across continuation frames. Returns true if the 
+	// packet is complete. If a frame does not continue the pending packet, a PacketException exception will be thrown.
+	bool assembleFrame(PACKET_TYPE& packet)
+	{
+		if (m_streamPacket.getOpcode() == PACKET_TYPE::INVALID_OPCODE)
+		{
+			if (!packet.isContinued())
+				return true;
+
+			m_streamPacket = std::move(packet);
+			return false;
+		}
+
+		m_streamPacket.appendFrame(std::move(packet));
+		if (m_streamPacket.isContinued())
+			return false;
+
+		packet = std::move(m_streamPacket);
+		m_streamPacket = PACKET_TYPE();
+		return true;
+	}
+
+	void addToWriteQueue(PACKET_TYPE&& packet)
+	{
+		SendLane lane = this->getSendLane(packet);
+		this->compressPacket(packet);
+		int32 size = packet.getByteSize();
+
+		if (m_sendQueueLimit != SEND_QUEUE_UNLIMITED && m_writeQueueSize + size > m_sendQueueLimit)
 		{
-			m_writeQueueSize += buff.getBufferSize();
-			m_writeQueue.push(std::move(buff));
-			this->processWriteQueue();
+			this->dropPackets(m_writeQueueSize + size - m_sendQueueLimit);
+			if (m_writeQueueSize + size > m_sendQueueLimit)
+			{
+				if (lane == SEND_LANE_DROPPABLE)
+				{
+					sNetworkStats->addDroppedPacket();
+					return;
+				}
+
+				int32 hardLimit = m_sendQueueHardLimit != SEND_QUEUE_UNLIMITED ? m_sendQueueHardLimit : m_sendQueueLimit;
+				if (m_writeQueueSize + size > hardLimit)
+				{
+					NS_LOG_WARN("network.socket", "Send queue is full (%d + %d > %d bytes). address: %s:%d", m_writeQueueSize, size, hardLimit, this->getRemoteAddress().to_string().c_str(), this->getRemotePort());
+					this->closeSocket();
+					return;
+				}
+			}
 		}
 
+		m_writeQueueSize += size;
+		this->addLaneBytes(lane, size);
+
+		WriteEntry entry;
+		entry.packet = std::move(packet);
+		entry.lane = lane;
+		entry.isDropped = false;
+		m_writeQueue.push_back(std::move(entry));
+	}
+
+	// Drop queued droppable packets, oldest first, until the specified number of bytes is released.
+	// Packets being written are not dropped. The entries stay in the queue, marked as dropped,
+	// because erasing from the middle of the deque would move the packets of the pending write
+	void dropPackets(int32 bytes)
+	{
+		if (m_laneBytes[SEND_LANE_DROPPABLE] == 0)
+			return;
+
+		int32 dropped = 0;
+		std::size_t first = m_isWritingAsync ? m_writingCount : 0;
+		for (std::size_t i = first; i < m_writeQueue.size() && dropped < bytes; ++i)
+		{
+			WriteEntry& entry = m_writeQueue[i];
+			if (entry.isDropped || entry.lane != SEND_LANE_DROPPABLE)
+				continue;
+
+			int32 size = entry.packet.getByteSize();
+			entry.packet = PACKET_TYPE();
+			entry.isDropped = true;
+			this->addLaneBytes(entry.lane, -size);
+			sNetworkStats->addDroppedPacket();
+			dropped += size;
+		}
+
+		m_writeQueueSize -= dropped;
+	}
+
+	void addLaneBytes(SendLane lane, int32 bytes)
+	{
+		m_laneBytes[lane] += bytes;
+		sNetworkStats->addQueuedBytes(lane, bytes);
 	}
 
 	void processWriteQueue()
@@ -234,25 +540,92 @@ private:
 		if (m_isWritingAsync)
 			return;
 
+		while (!m_writeQueue.empty() && m_writeQueue.front().isDropped)
+			m_writeQueue.pop_front();
+
+		if (m_writeQueue.empty())
+			return;
+
 		m_isWritingAsync = true;
 
-		MessageBuffer& buff = m_writeQueue.front();
+		// Collect as many queued packets as possible into the next write.
+		// The packets stay in the write queue until the write has completed, 
+		// the deque guarantees that their addresses do not change when new packets are appended
+		m_writeBuffers.clear();
+		m_writingCount = 0;
+		m_writingPackets = 0;
+		m_writingBytes = 0;
+		for (auto it = m_writeQueue.begin(); it != m_writeQueue.end() && m_writingPackets < MAX_WRITE_BATCH_PACKETS; ++it)
+		{
+			WriteEntry& entry = *it;
+			if (entry.isDropped)
+			{
+				++m_writingCount;
+				continue;
+			}
+
+			PACKET_TYPE& packet = entry.packet;
+			if (m_writingPackets > 0 && m_writingBytes + packet.getByteSize() > MAX_WRITE_BATCH_BYTES)
+				break;
+
+			if (m_isGatherWrite)
+			{
+				packet.encodeHeader();
+				for (uint32 frame = 0, frameCount = packet.getFrameCount(); frame < frameCount; ++frame)
+				{
+					m_writeBuffers.push_back(boost::asio::buffer(packet.getHeaderPointer(frame), PACKET_TYPE::HEADER_BYTE_SIZE));
+					if (packet.getFrameBodyBytes(frame) > 0)
+						m_writeBuffers.push_back(boost::asio::buffer(packet.getFrameBodyData(frame), packet.getFrameBodyBytes(frame)));
+				}
+			}
+
+			++m_writingCount;
+			++m_writingPackets;
+			m_writingBytes += packet.getByteSize();
+		}
+
+		if (!m_isGatherWrite)
+		{
+			m_coalesceBuffer.resize(static_cast<uint32>(m_writingBytes));
+			m_coalesceBuffer.reset();
+			for (std::size_t i = 0; i < m_writingCount; ++i)
+			{
+				if (!m_writeQueue[i].isDropped)
+					m_writeQueue[i].packet.write(m_coalesceBuffer);
+			}
+			m_writeBuffers.push_back(boost::asio::buffer(m_coalesceBuffer.getReadPointer(), m_coalesceBuffer.getActiveSize()));
+		}
+
 		auto self(this->shared_from_this());
-		boost::asio::async_write(m_socket, boost::asio::buffer(buff.getReadPointer(), buff.getActiveSize()),
-			[this, self, &buff](boost::system::error_code const& error, std::size_t bytes_transferred)
+		boost::asio::async_write(m_socket, m_writeBuffers,
+			[this, self](boost::system::error_code const& error, std::size_t bytes_transferred)
 		{
 			if (!error)
 			{
 				m_isWritingAsync = false;
 
-				NS_ASSERT(bytes_transferred == buff.getActiveSize());
-				buff.readCompleted(static_cast<uint16>(bytes_transferred));
+				NS_ASSERT(bytes_transferred == m_writingBytes);
+				sNetworkStats->addWrite(static_cast<uint32>(m_writingPackets), static_cast<uint32>(m_writingBytes));
+
+				int64 now = getSteadyTimeMicros();
+				for (std::size_t i = 0; i < m_writingCount; ++i)
+				{
+					WriteEntry& entry = m_writeQueue[i];
+					if (entry.isDropped)
+						continue;
+
+					sNetworkStats->addSendLatency(now - entry.packet.getTimestamp());
+					this->onPacketWritten(entry.packet, now - entry.packet.getTimestamp());
+					this->addLaneBytes(entry.lane, -static_cast<int32>(entry.packet.getByteSize()));
+				}
 
-				m_writeQueueSize -= buff.getBufferSize();
-				m_writeQueue.pop();
+				m_writeQueueSize -= static_cast<int32>(m_writingBytes);
+				m_writeQueue.erase(m_writeQueue.begin(), m_writeQueue.begin() + m_writingCount);
+				m_writingCount = 0;
+				m_writingPackets = 0;
+				m_writingBytes = 0;
 
-				if(!m_writeQueue.empty())
-					this->processWriteQueue();
+				this->processWriteQueue();
 			}
 			else
 			{
@@ -262,13 +635,39 @@ private:
 	}
 
 	PACKET_TYPE m_readPacket;
-	MessageBuffer m_readBuffer;
+	// The frames received so far of a packet streamed across continuation frames
+	PACKET_TYPE m_streamPacket;
+	// Shared with the received packets that borrow their bodies from it
+	std::shared_ptr<MessageBuffer> m_readBuffer;
+	// Receive buffers replaced while packets borrowed from them, see reclaimReadBuffer()
+	std::vector<std::shared_ptr<MessageBuffer>> m_spareReadBuffers;
+	std::vector<PACKET_TYPE> m_readBatch;
+
+	struct WriteEntry
+	{
+		PACKET_TYPE packet;
+		SendLane lane;
+		bool isDropped;
+	};
 
 	int32 m_sendQueueLimit;
+	int32 m_sendQueueHardLimit;
 	int32 m_writeQueueSize;
-	ConcurrentQueue<PACKET_TYPE> m_packetQueue;
-	std::queue<MessageBuffer> m_writeQueue;
+	int32 m_laneBytes[MAX_SEND_LANES];
+	MPSCQueue<PACKET_TYPE> m_packetQueue;
+	std::deque<WriteEntry> m_writeQueue;
+	// The number of queue entries (including dropped ones), packets and bytes of the pending write
+	std::size_t m_writingCount;
+	std::size_t m_writingPackets;
+	std::size_t m_writingBytes;
+	std::vector<boost::asio::const_buffer> m_writeBuffers;
+	MessageBuffer m_coalesceBuffer;
+	bool m_isGatherWrite;
 	bool m_isWritingAsync;
+	bool m_isEventDrivenFlush;
+	std::atomic<bool> m_isFlushPending;
+	bool m_isStreamingRead;
+	bool m_isZeroCopyRead;
 
 	std::atomic<bool> m_isClosed;
 	tcp::socket m_socket;
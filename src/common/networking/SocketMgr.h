@@ -31,13 +31,24 @@ public:
 		if (!this->loadConfig())
 			return false;
 
-		NS_ASSERT(m_acceptor == nullptr, "Acceptor has been initialized.");
-		m_acceptor = new AsyncAcceptor(service);
-		m_acceptor->setSendBufferSize(m_sockOutKBuff);
-		m_acceptor->setTcpNoDelay(m_tcpNoDelay);
+		if (m_reusePort && !AsyncAcceptor::isReusePortSupported())
+		{
+			NS_LOG_WARN("network.socket", "SO_REUSEPORT is not supported on this platform, Network.ReusePort is ignored.");
+			m_reusePort = false;
+		}
 
-		if (!m_acceptor->listen(bindIp, port))
-			return false;
+		if (!m_reusePort)
+		{
+			NS_ASSERT(m_acceptor == nullptr, "Acceptor has been initialized.");
+			m_acceptor = std::make_shared<AsyncAcceptor>(service);
+			m_acceptor->setSendBufferSize(m_sockOutKBuff);
+			m_acceptor->setTcpNoDelay(m_tcpNoDelay);
+			if (m_admissionEnabled)
+				m_acceptor->setAdmissionControl(&m_admissionControl);
+
+			if (!m_acceptor->listen(bindIp, port))
+				return false;
+		}
 
 		NS_ASSERT(m_threads == nullptr, "Threads has been created.");
         m_threadCount = threadCount;
@@ -45,11 +56,30 @@ public:
 
         NS_ASSERT(m_threads);
 
+		NS_LOG_INFO("network.socket", "Network I/O backend: %s", getNetworkBackendName());
+
 		for (uint32 i = 0; i < m_threadCount; ++i)
+		{
+			m_threads[i].setUpdateInterval(m_eventDrivenFlush ? HOUSEKEEPING_TIMER_INTERVAL : UPDATE_TIMER_INTERVAL);
+			m_threads[i].setThreadIndex(i);
+			m_threads[i].setSpinTime(m_spinTime);
 			m_threads[i].start();
- 
-		m_acceptor->asyncAccept(std::bind(&SocketMgr::onSocketOpen, this, std::placeholders::_1, std::placeholders::_2), 
-								std::bind(&SocketMgr::getSocketForAccept, this));
+		}
+
+		if (m_reusePort)
+		{
+			// Each network thread listens on the same port and accepts connections on its own io_service
+			for (uint32 i = 0; i < m_threadCount; ++i)
+			{
+				if (!this->startThreadAcceptor(i, bindIp, port))
+					return false;
+			}
+		}
+		else
+		{
+			m_acceptor->asyncAccept(std::bind(&SocketMgr::onSocketOpen, this, std::placeholders::_1, std::placeholders::_2), 
+									std::bind(&SocketMgr::getSocketForAccept, this));
+		}
 
         return true;
     }
@@ -70,7 +100,15 @@ protected:
 		m_threadCount(0),
 		m_tcpNoDelay(false),
 		m_sockOutKBuff(-1),
-		m_sendQueueLimit(0)
+		m_sendQueueLimit(0),
+		m_sendQueueHardLimit(0),
+		m_gatherWrite(true),
+		m_eventDrivenFlush(true),
+		m_streamingRead(true),
+		m_zeroCopyRead(true),
+		m_reusePort(false),
+		m_spinTime(0),
+		m_admissionEnabled(false)
     {
     }
 
@@ -83,6 +121,26 @@ protected:
 
 		m_sockOutKBuff = sConfigMgr->getIntDefault("Network.OutKBuff", -1);
 		m_sendQueueLimit = sConfigMgr->getIntDefault("Network.SendQueueLimit", 0);
+		m_sendQueueHardLimit = sConfigMgr->getIntDefault("Network.SendQueueHardLimit", 0);
+		m_gatherWrite = sConfigMgr->getBoolDefault("Network.GatherWrite", true);
+		m_eventDrivenFlush = sConfigMgr->getBoolDefault("Network.EventDrivenFlush", true);
+		m_streamingRead = sConfigMgr->getBoolDefault("Network.StreamingRead", true);
+		m_zeroCopyRead = sConfigMgr->getBoolDefault("Network.ZeroCopyRead", true);
+		m_reusePort = sConfigMgr->getBoolDefault("Network.ReusePort", false);
+		m_spinTime = std::max(sConfigMgr->getIntDefault("Network.SpinTime", 0), 0);
+
+		m_admissionEnabled = sConfigMgr->getBoolDefault("Network.Admission.Enable", false);
+		if (m_admissionEnabled)
+		{
+			float perIpRate = std::max(sConfigMgr->getFloatDefault("Network.Admission.PerIpRate", 5.f), 0.f);
+			float perIpBurst = std::max(sConfigMgr->getFloatDefault("Network.Admission.PerIpBurst", 20.f), 1.f);
+			float globalRate = std::max(sConfigMgr->getFloatDefault("Network.Admission.GlobalRate", 500.f), 0.f);
+			float globalBurst = std::max(sConfigMgr->getFloatDefault("Network.Admission.GlobalBurst", 1000.f), 1.f);
+			m_admissionControl.configure(perIpRate, perIpBurst, globalRate, globalBurst);
+
+			NS_LOG_INFO("network.socket", "Admission control: %.1f connections/s per IP (burst %.0f), %.1f connections/s global (burst %.0f)",
+				perIpRate, perIpBurst, globalRate, globalBurst);
+		}
 
 		return true;
 	}
@@ -93,6 +151,11 @@ protected:
 		{
 			std::shared_ptr<SOCKET_TYPE> newSocket = std::make_shared<SOCKET_TYPE>(std::move(socket));
 			newSocket->setSendQueueLimit(m_sendQueueLimit);
+			newSocket->setSendQueueHardLimit(m_sendQueueHardLimit);
+			newSocket->setGatherWrite(m_gatherWrite);
+			newSocket->setEventDrivenFlush(m_eventDrivenFlush);
+			newSocket->setStreamingRead(m_streamingRead);
+			newSocket->setZeroCopyRead(m_zeroCopyRead);
 			m_threads[threadIndex].addSocket(newSocket);
 		}
 		catch (boost::system::system_error const& error)
@@ -118,17 +181,37 @@ protected:
 		return std::make_pair(m_threads[threadIndex].getSocketForAccept(), threadIndex);
 	}
 
+	bool startThreadAcceptor(uint32 threadIndex, std::string const& bindIp, uint16 port)
+	{
+		std::shared_ptr<AsyncAcceptor> acceptor = std::make_shared<AsyncAcceptor>(m_threads[threadIndex].getIoService());
+		m_threadAcceptors.push_back(acceptor);
+		acceptor->setSendBufferSize(m_sockOutKBuff);
+		acceptor->setTcpNoDelay(m_tcpNoDelay);
+		acceptor->setReusePort(true);
+		if (m_admissionEnabled)
+			acceptor->setAdmissionControl(&m_admissionControl);
+
+		if (!acceptor->listen(bindIp, port))
+			return false;
+
+		NetworkThread<SOCKET_TYPE>* thread = &m_threads[threadIndex];
+		acceptor->asyncAccept(std::bind(&SocketMgr::onSocketOpen, this, std::placeholders::_1, std::placeholders::_2),
+			[thread, threadIndex]() { return std::make_pair(thread->getSocketForAccept(), threadIndex); });
+
+		return true;
+	}
+
 	virtual NetworkThread<SOCKET_TYPE>* createThreads(uint32 count) const
 	{
 		return new NetworkThread<SOCKET_TYPE>[count]();
 	}
 
+	// The acceptor on the main io_service is closed on its strand, while the io_service keeps running
 	void closeAcceptor()
 	{
 		if (m_acceptor)
 		{
 			m_acceptor->close();
-			delete m_acceptor;
 			m_acceptor = nullptr;
 		}
 	}
@@ -140,6 +223,12 @@ protected:
 			for (uint32 i = 0; i < m_threadCount; ++i)
 				m_threads[i].stop();
 
+			// The acceptors of the network threads are closed once the threads have been joined, so none of 
+			// their handlers can run concurrently. Their io_services must still exist while they are closed
+			for (auto const& acceptor : m_threadAcceptors)
+				acceptor->close();
+			m_threadAcceptors.clear();
+
 			delete[] m_threads;
 			m_threads = nullptr;
 
@@ -147,13 +236,24 @@ protected:
 		}
 	}
 
-    AsyncAcceptor* m_acceptor;
+    std::shared_ptr<AsyncAcceptor> m_acceptor;
+	// The acceptors of the network threads if SO_REUSEPORT is used
+	std::vector<std::shared_ptr<AsyncAcceptor>> m_threadAcceptors;
     NetworkThread<SOCKET_TYPE>* m_threads;
     uint32 m_threadCount;
 
 	bool m_tcpNoDelay;
 	int32 m_sockOutKBuff;
 	int32 m_sendQueueLimit;
+	int32 m_sendQueueHardLimit;
+	bool m_gatherWrite;
+	bool m_eventDrivenFlush;
+	bool m_streamingRead;
+	bool m_zeroCopyRead;
+	bool m_reusePort;
+	int32 m_spinTime;
+	bool m_admissionEnabled;
+	AdmissionControl m_admissionControl;
 };
 
 #endif // __SOCKET_MGR_H__
@@ -0,0 +1,108 @@
+#include "ThreadAffinity.h"
+
+#include <sstream>
+
+#include "logging/Log.h"
+#include "configuration/Config.h"
+#include "utilities/Util.h"
+
+#if PLATFORM == PLATFORM_UNIX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// The cores that setCurrentThreadAffinity() can address are below this limit
+static int32 getCoreLimit()
+{
+#if PLATFORM == PLATFORM_WINDOWS
+	return int32(sizeof(DWORD_PTR) * 8);
+#elif PLATFORM == PLATFORM_UNIX && defined(__linux__)
+	return CPU_SETSIZE;
+#else
+	return 0;
+#endif
+}
+
+std::vector<int32> parseCoreList(std::string const& list, std::string const& logChannel)
+{
+	std::vector<int32> cores;
+	int32 limit = getCoreLimit();
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		int32 first = -1;
+		int32 last = -1;
+		char dash = 0;
+		std::stringstream range(item);
+		range >> first;
+		if (range >> dash)
+		{
+			if (dash != '-' || !(range >> last))
+				continue;
+		}
+		else
+			last = first;
+
+		if (first < 0 || last < first)
+			continue;
+
+		// A large range such as "0-999999999" would otherwise expand to a huge list
+		if (first >= limit)
+		{
+			NS_LOG_ERROR(logChannel, "Core list entry '%s' is skipped, cores must be below %d.", item.c_str(), limit);
+			continue;
+		}
+
+		if (last >= limit)
+		{
+			NS_LOG_ERROR(logChannel, "Core list entry '%s' is clamped to %d-%d, cores must be below %d.", item.c_str(), first, limit - 1, limit);
+			last = limit - 1;
+		}
+
+		for (int32 core = first; core <= last; ++core)
+			cores.push_back(core);
+	}
+
+	return cores;
+}
+
+bool setCurrentThreadAffinity(int32 core)
+{
+#if PLATFORM == PLATFORM_WINDOWS
+	if (core >= int32(sizeof(DWORD_PTR) * 8))
+		return false;
+
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+#elif PLATFORM == PLATFORM_UNIX && defined(__linux__)
+	if (core >= CPU_SETSIZE)
+		return false;
+
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	CPU_SET(core, &mask);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+#else
+	(void)core;
+	return false;
+#endif
+}
+
+int32 pinCurrentThread(std::string const& configKey, uint32 index, std::string const& logChannel)
+{
+	std::vector<int32> cores = parseCoreList(sConfigMgr->getStringDefault(configKey, ""), logChannel);
+	if (cores.empty())
+		return -1;
+
+	int32 core = cores[index % cores.size()];
+	if (!setCurrentThreadAffinity(core))
+	{
+		NS_LOG_ERROR(logChannel, "Can't pin thread(ID=%s) to core %d (%s).", getCurrentThreadId().c_str(), core, configKey.c_str());
+		return -1;
+	}
+
+	NS_LOG_INFO(logChannel, "Thread(ID=%s) is pinned to core %d (%s).", getCurrentThreadId().c_str(), core, configKey.c_str());
+
+	return core;
+}
@@ -0,0 +1,36 @@
+#ifndef __THREAD_AFFINITY_H__
+#define __THREAD_AFFINITY_H__
+
+#include <vector>
+
+#include "Common.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Parse a list of cores such as "0,2,4-7". Invalid entries are skipped. Cores beyond the 
+// affinity mask of the platform are skipped or clamped and logged to the channel
+std::vector<int32> parseCoreList(std::string const& list, std::string const& logChannel);
+
+// Pin the calling thread to the core at the index in the core list read from the config key. 
+// The index wraps around the list, so a short list is shared by all threads. 
+// Nothing is done if the list is empty. Returns the core, or -1 if the thread was not pinned
+int32 pinCurrentThread(std::string const& configKey, uint32 index, std::string const& logChannel);
+
+// Pin the calling thread to a single core. Supported on Linux and Windows
+bool setCurrentThreadAffinity(int32 core);
+
+// Hint to the processor that the thread is spinning
+inline void cpuRelax()
+{
+#if defined(_MSC_VER)
+	_mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+#endif // __THREAD_AFFINITY_H__
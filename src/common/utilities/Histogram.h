@@ -0,0 +1,129 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <atomic>
+#include <cmath>
+
+#include "Common.h"
+
+// Lock-free histogram of non-negative samples, such as latencies in microseconds.
+// Each power of two is split into 8 buckets, so a reported percentile is within 12.5%
+// of the real value. Samples may be added from any thread
+class Histogram
+{
+public:
+	enum
+	{
+		SUB_BUCKET_BITS = 3,
+		SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS,
+		// Samples up to 2^32 - 1 are counted, larger samples fall into the last bucket
+		BUCKET_COUNT = (32 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT,
+	};
+
+	Histogram()
+	{
+		this->reset();
+	}
+
+	Histogram(Histogram const& right) = delete;
+	Histogram& operator=(Histogram const& right) = delete;
+
+	void add(int64 value)
+	{
+		uint64 v = value > 0 ? static_cast<uint64>(value) : 0;
+		m_buckets[getBucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_sum.fetch_add(v, std::memory_order_relaxed);
+
+		uint64 max = m_max.load(std::memory_order_relaxed);
+		while (v > max && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed))
+			;
+	}
+
+	void reset()
+	{
+		for (int32 i = 0; i < BUCKET_COUNT; ++i)
+			m_buckets[i].store(0, std::memory_order_relaxed);
+		m_count.store(0, std::memory_order_relaxed);
+		m_sum.store(0, std::memory_order_relaxed);
+		m_max.store(0, std::memory_order_relaxed);
+	}
+
+	// Add the samples of another histogram
+	void merge(Histogram const& right)
+	{
+		for (int32 i = 0; i < BUCKET_COUNT; ++i)
+			m_buckets[i].fetch_add(right.m_buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		m_count.fetch_add(right.getCount(), std::memory_order_relaxed);
+		m_sum.fetch_add(right.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+		uint64 rightMax = right.getMax();
+		uint64 max = m_max.load(std::memory_order_relaxed);
+		while (rightMax > max && !m_max.compare_exchange_weak(max, rightMax, std::memory_order_relaxed))
+			;
+	}
+
+	uint64 getCount() const { return m_count.load(std::memory_order_relaxed); }
+	uint64 getMax() const { return m_max.load(std::memory_order_relaxed); }
+	double getMean() const
+	{
+		uint64 count = this->getCount();
+		return count > 0 ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count : 0.0;
+	}
+
+	// Returns the upper bound of the bucket that contains the specified percentile (0-100)
+	uint64 getPercentile(double percentile) const
+	{
+		uint64 count = this->getCount();
+		if (count == 0)
+			return 0;
+
+		uint64 rank = static_cast<uint64>(std::ceil(count * percentile / 100.0));
+		if (rank == 0)
+			rank = 1;
+
+		uint64 seen = 0;
+		for (int32 i = 0; i < BUCKET_COUNT; ++i)
+		{
+			seen += m_buckets[i].load(std::memory_order_relaxed);
+			if (seen >= rank)
+				return std::min(getBucketUpperBound(i), this->getMax());
+		}
+
+		return this->getMax();
+	}
+
+private:
+	static int32 getBucketIndex(uint64 value)
+	{
+		if (value < SUB_BUCKET_COUNT)
+			return static_cast<int32>(value);
+
+		if (value >> 32)
+			return BUCKET_COUNT - 1;
+
+		int32 msb = SUB_BUCKET_BITS;
+		while (value >> (msb + 1))
+			++msb;
+
+		int32 sub = static_cast<int32>((value >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1));
+		return (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub;
+	}
+
+	static uint64 getBucketUpperBound(int32 index)
+	{
+		if (index < SUB_BUCKET_COUNT)
+			return static_cast<uint64>(index);
+
+		int32 shift = index / SUB_BUCKET_COUNT - 1;
+		uint64 sub = static_cast<uint64>(index % SUB_BUCKET_COUNT);
+		return ((SUB_BUCKET_COUNT + sub + 1) << shift) - 1;
+	}
+
+	std::atomic<uint64> m_buckets[BUCKET_COUNT];
+	std::atomic<uint64> m_count;
+	std::atomic<uint64> m_sum;
+	std::atomic<uint64> m_max;
+};
+
+#endif // __HISTOGRAM_H__
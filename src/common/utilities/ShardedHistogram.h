@@ -0,0 +1,64 @@
+#ifndef __SHARDED_HISTOGRAM_H__
+#define __SHARDED_HISTOGRAM_H__
+
+#include "Histogram.h"
+
+// Histogram for samples added by many threads at a high rate, such as the latencies of all packets.
+// Each thread adds its samples to its own shard, so the threads do not contend on the buckets of a
+// single histogram, and the shards are merged when the histogram is read. Samples may be added from any thread
+class ShardedHistogram
+{
+public:
+	enum
+	{
+		// The threads are assigned to the shards in turn, so more threads than shards share some of them
+		SHARD_COUNT = 8,
+		CACHE_LINE_SIZE = 64
+	};
+
+	ShardedHistogram() {}
+
+	ShardedHistogram(ShardedHistogram const& right) = delete;
+	ShardedHistogram& operator=(ShardedHistogram const& right) = delete;
+
+	void add(int64 value) { m_shards[getShardIndex()].histogram.add(value); }
+
+	void reset()
+	{
+		for (int32 i = 0; i < SHARD_COUNT; ++i)
+			m_shards[i].histogram.reset();
+	}
+
+	// Merge the samples of all shards into the histogram
+	void collect(Histogram& result) const
+	{
+		for (int32 i = 0; i < SHARD_COUNT; ++i)
+			result.merge(m_shards[i].histogram);
+	}
+
+	uint64 getCount() const
+	{
+		uint64 count = 0;
+		for (int32 i = 0; i < SHARD_COUNT; ++i)
+			count += m_shards[i].histogram.getCount();
+		return count;
+	}
+
+private:
+	// Aligned so the buckets of neighbouring shards do not share a cache line
+	struct alignas(CACHE_LINE_SIZE) Shard
+	{
+		Histogram histogram;
+	};
+
+	static int32 getShardIndex()
+	{
+		static std::atomic<uint32> nextIndex(0);
+		static thread_local int32 index = static_cast<int32>(nextIndex.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT);
+		return index;
+	}
+
+	Shard m_shards[SHARD_COUNT];
+};
+
+#endif // __SHARDED_HISTOGRAM_H__
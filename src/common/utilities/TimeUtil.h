@@ -33,6 +33,15 @@ inline double getHighResolutionTimeMillis()
 	return msDouble;
 }
 
+// Monotonic time in microseconds, used to measure short intervals
+inline int64 getSteadyTimeMicros()
+{
+	using namespace std::chrono;
+
+	int64 time = int64(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+	return time;
+}
+
 inline NSTime convertSecToMillis(float seconds)
 {
 	return static_cast<NSTime>(seconds * 1000);
@@ -0,0 +1,64 @@
+#ifndef __TOKEN_BUCKET_H__
+#define __TOKEN_BUCKET_H__
+
+#include <algorithm>
+
+#include "Common.h"
+
+// Token bucket rate limiter. Tokens are added at a constant rate (per second) up to the
+// burst size, and each admitted event takes one token. The caller passes the current
+// time in microseconds, e.g. getSteadyTimeMicros(). The class is not thread-safe
+class TokenBucket
+{
+public:
+	TokenBucket() :
+		m_rate(0.0),
+		m_burst(0.0),
+		m_tokens(0.0),
+		m_lastTime(0)
+	{
+	}
+
+	TokenBucket(double rate, double burst, int64 now) :
+		m_rate(rate),
+		m_burst(burst),
+		m_tokens(burst),
+		m_lastTime(now)
+	{
+	}
+
+	// Take one token. Returns false if the bucket is empty
+	bool consume(int64 now)
+	{
+		this->refill(now);
+		if (m_tokens < 1.0)
+			return false;
+
+		m_tokens -= 1.0;
+		return true;
+	}
+
+	// Returns true if the bucket would be full at the specified time, i.e. it has
+	// been idle long enough that forgetting it does not change any decision
+	bool isFull(int64 now) const
+	{
+		return m_tokens + (now - m_lastTime) * m_rate / 1000000.0 >= m_burst;
+	}
+
+private:
+	void refill(int64 now)
+	{
+		if (now > m_lastTime)
+		{
+			m_tokens = std::min(m_burst, m_tokens + (now - m_lastTime) * m_rate / 1000000.0);
+			m_lastTime = now;
+		}
+	}
+
+	double m_rate;
+	double m_burst;
+	double m_tokens;
+	int64 m_lastTime;
+};
+
+#endif // __TOKEN_BUCKET_H__
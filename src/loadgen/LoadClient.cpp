@@ -0,0 +1,606 @@
+#include "LoadClient.h"
+
+#include "utilities/TimeUtil.h"
+#include "utilities/StringUtil.h"
+#include "game/entities/updates/UpdateObject.h"
+#include "game/entities/updates/ObjectUpdateFields.h"
+#include "game/server/protocol/pb/AuthProof.pb.h"
+#include "game/server/protocol/pb/AuthVerdict.pb.h"
+#include "game/server/protocol/pb/PlayerLogin.pb.h"
+#include "game/server/protocol/pb/JoinTheater.pb.h"
+#include "game/server/protocol/pb/AttackInfo.pb.h"
+#include "game/server/protocol/pb/UseItem.pb.h"
+#include "game/server/protocol/pb/TimeSyncReq.pb.h"
+#include "game/server/protocol/pb/TimeSyncResp.pb.h"
+#include "game/server/protocol/pb/Ping.pb.h"
+#include "game/server/protocol/pb/Pong.pb.h"
+
+// Same values as MovementFlag in DataUnit.h, which is not included to keep the map code out of the build
+#define MOVEMENT_FLAG_WALKING		0x1
+// Same value as RequiredCapabilities in WorldSession.h
+#define REQUIRES_STREAMING			0x00000008
+
+// Delay before a client whose battle has ended connects again. Unit: milliseconds
+#define REJOIN_DELAY				1000
+
+// Find the create block of the client's own character in the body of SMSG_UPDATE_OBJECT and read its movement.
+// The blocks are not length-prefixed and only the player layout is known here, so the body is scanned for a
+// block that starts with the header of a player created with UPDATE_FLAG_SELF whose movement has the same guid
+static bool findSelfMovement(uint8 const* data, int32 size, MovementInfo& movement)
+{
+	enum
+	{
+		MASK_BLOCK_COUNT = (SPLAYER_END + 31) / 32
+	};
+
+	for (int32 offset = 0; offset < size; ++offset)
+	{
+		// The update type is the first byte of a block
+		if (data[offset] != UPDATE_TYPE_CREATE)
+			continue;
+
+		DataInputStream input(data + offset, size - offset);
+		int updateType = 0;
+		uint32 updateFlags = 0;
+		uint32 guid = 0;
+		int typeId = 0;
+		if (!Parcel::readEnum(&input, &updateType)
+			|| !Parcel::readUInt32(&input, &updateFlags) || (updateFlags & UPDATE_FLAG_SELF) == 0
+			|| !Parcel::readUInt32(&input, &guid) || !ObjectGuid(guid).isPlayer()
+			|| !Parcel::readEnum(&input, &typeId) || typeId != DATA_TYPEID_PLAYER)
+			continue;
+
+		uint32 mask[MASK_BLOCK_COUNT];
+		bool isValid = true;
+		for (int32 i = 0; i < MASK_BLOCK_COUNT && isValid; ++i)
+			isValid = Parcel::readFixedUint32(&input, &mask[i]);
+		if (!isValid || (mask[0] & (1 << SUNIT_FIELD_MOVEMENT_INFO)) == 0)
+			continue;
+
+		// The fields in front of the movement
+		int32 health = 0;
+		if ((mask[0] & (1 << SUNIT_FIELD_HEALTH)) != 0 && !Parcel::readInt32(&input, &health))
+			continue;
+		if ((mask[0] & (1 << SUNIT_FIELD_MAX_HEALTH)) != 0 && !Parcel::readInt32(&input, &health))
+			continue;
+
+		MovementInfo info;
+		if (!info.readFromStream(&input) || info.guid.getRawValue() != guid)
+			continue;
+
+		movement = info;
+		return true;
+	}
+
+	return false;
+}
+
+LoadClient::LoadClient(boost::asio::io_service& service, LoadSettings const& settings, LoadStats& stats, uint32 index) :
+	m_strand(service),
+	m_socket(service),
+	m_actionTimer(service),
+	m_reconnectTimer(service),
+	m_settings(settings),
+	m_stats(stats),
+	m_index(index),
+	m_state(STATE_IDLE),
+	m_isStopped(false),
+	m_connectStartTime(0),
+	m_authStartTime(0),
+	m_readBuffer(READ_BUFFER_SIZE),
+	m_isWriting(false),
+	m_isTimeSynced(false),
+	m_moveStep(0),
+	m_attackCounter(0),
+	m_nextMoveTime(0),
+	m_nextAttackTime(0),
+	m_nextUseItemTime(0),
+	m_nextPingTime(0),
+	m_pingCounter(0),
+	m_pingSentTime(0),
+	m_lastPingLatency(0)
+{
+}
+
+void LoadClient::start()
+{
+	auto self(this->shared_from_this());
+	m_strand.post([this, self]() {
+		this->connect();
+	});
+}
+
+void LoadClient::stop()
+{
+	auto self(this->shared_from_this());
+	m_strand.post([this, self]() {
+		m_isStopped = true;
+		m_reconnectTimer.cancel();
+		this->close(false);
+	});
+}
+
+void LoadClient::connect()
+{
+	if (m_isStopped)
+		return;
+
+	m_state = STATE_CONNECTING;
+	m_connectStartTime = getSteadyTimeMicros();
+
+	auto self(this->shared_from_this());
+	m_socket.async_connect(m_settings.endpoint, m_strand.wrap([this, self](boost::system::error_code const& error)
+	{
+		if (m_isStopped)
+			return;
+
+		if (error)
+		{
+			m_stats.onConnectFailed();
+			m_state = STATE_IDLE;
+			boost::system::error_code ec;
+			m_socket.close(ec);
+			return;
+		}
+
+		int64 now = getSteadyTimeMicros();
+		m_stats.onConnected();
+		m_stats.addConnectLatency(now - m_connectStartTime);
+
+		boost::system::error_code ec;
+		m_socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+
+		m_readBuffer.reset();
+		m_streamPacket = LoadPacket();
+		m_writeQueue.clear();
+		m_isWriting = false;
+		m_isTimeSynced = false;
+		m_attackCounter = 0;
+		m_moveStep = 0;
+		m_pingSentTime = 0;
+
+		// The server does not send an auth challenge, the client starts with its proof
+		AuthProof proof;
+		proof.set_playerid(StringUtil::format("loadgen-%u", m_index));
+		proof.set_session_id(0);
+		if (m_settings.streaming)
+			proof.set_required_capabilities(REQUIRES_STREAMING);
+		m_state = STATE_AUTHENTICATING;
+		m_authStartTime = now;
+		this->sendPacket(CMSG_AUTH_PROOF, proof);
+
+		// Pings keep the session alive while it waits for the battle to start
+		m_nextPingTime = now + m_settings.pingInterval * 1000LL;
+		this->scheduleAction();
+
+		this->readSome();
+	}));
+}
+
+void LoadClient::close(bool byServer)
+{
+	if (m_state == STATE_IDLE || m_state == STATE_CONNECTING)
+	{
+		boost::system::error_code ec;
+		m_socket.close(ec);
+		return;
+	}
+
+	m_stats.onDisconnected(byServer, m_state == STATE_IN_BATTLE);
+	m_state = STATE_IDLE;
+	m_actionTimer.cancel();
+
+	boost::system::error_code ec;
+	m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+	m_socket.close(ec);
+}
+
+void LoadClient::readSome()
+{
+	m_readBuffer.normalize();
+	auto self(this->shared_from_this());
+	m_socket.async_read_some(boost::asio::buffer(m_readBuffer.getWritePointer(), m_readBuffer.getRemainingSpace()),
+		m_strand.wrap([this, self](boost::system::error_code const& error, std::size_t transferredBytes)
+	{
+		if (m_state == STATE_IDLE)
+			return;
+
+		if (error)
+		{
+			this->close(true);
+			return;
+		}
+
+		m_readBuffer.writeCompleted(static_cast<uint32>(transferredBytes));
+		if (this->parseReadBuffer() && m_state != STATE_IDLE)
+			this->readSome();
+	}));
+}
+
+bool LoadClient::parseReadBuffer()
+{
+	try
+	{
+		while (m_readBuffer.getActiveSize() >= LoadPacket::HEADER_BYTE_SIZE)
+		{
+			uint16 bodyBytes = LoadPacket::peekBodyBytes(m_readBuffer.getReadPointer());
+			if (bodyBytes <= LoadPacket::MAX_BODY_BYTE_SIZE
+				&& m_readBuffer.getActiveSize() < LoadPacket::HEADER_BYTE_SIZE + bodyBytes)
+				break;
+
+			LoadPacket packet;
+			packet.decodeHeader(m_readBuffer);
+			packet.readBody(m_readBuffer);
+			m_stats.addReceived(packet.getByteSize());
+
+			// The frames of a streamed packet are collected until the last one
+			if (m_streamPacket.getOpcode() != LoadPacket::INVALID_OPCODE)
+			{
+				m_streamPacket.appendFrame(std::move(packet));
+				if (m_streamPacket.isContinued())
+					continue;
+
+				packet = std::move(m_streamPacket);
+				m_streamPacket = LoadPacket();
+			}
+			else if (packet.isContinued())
+			{
+				m_streamPacket = std::move(packet);
+				continue;
+			}
+
+			this->handlePacket(packet);
+			if (m_state == STATE_IDLE)
+				return false;
+		}
+	}
+	catch (PacketException const& ex)
+	{
+		printf("Client %u: %s\n", m_index, ex.what());
+		m_stats.onProtocolError();
+		this->close(false);
+		return false;
+	}
+
+	return true;
+}
+
+void LoadClient::handlePacket(LoadPacket& packet)
+{
+	switch (packet.getOpcode())
+	{
+	case SMSG_AUTH_VERDICT:
+		this->handleAuthVerdict(packet);
+		break;
+	case SMSG_THEATER_INFO:
+		this->handleTheaterInfo(packet);
+		break;
+	case SMSG_UPDATE_OBJECT:
+		this->handleUpdateObject(packet);
+		break;
+	case SMSG_TIME_SYNC_REQ:
+		this->handleTimeSyncReq(packet);
+		break;
+	case MSG_PONG:
+		this->handlePong(packet);
+		break;
+	case MSG_MOVE_START:
+	case MSG_MOVE_SYNC:
+	case MSG_MOVE_HEARTBEAT:
+	case MSG_MOVE_TURN:
+	case MSG_MOVE_STOP:
+		this->handleMovement(packet);
+		break;
+	case SMSG_BATTLE_RESULT:
+		this->handleBattleResult(packet);
+		break;
+	default:
+		// The other packets are only counted
+		break;
+	}
+}
+
+void LoadClient::handleAuthVerdict(LoadPacket& packet)
+{
+	AuthVerdict verdict;
+	packet.unpack(verdict);
+
+	// The time from the start of the connect to the verdict covers the accept and the session creation of the server
+	if (m_state == STATE_AUTHENTICATING)
+		m_stats.addAuthLatency(m_connectStartTime, getSteadyTimeMicros());
+
+	switch (verdict.result())
+	{
+	case AuthVerdict::AUTH_OK:
+	{
+		if (m_settings.authOnly)
+			break;
+
+		PlayerLogin login;
+		login.set_char_id(m_settings.charId);
+		login.set_screen_width(1280);
+		login.set_screen_height(720);
+		login.set_lang("en-US");
+		login.set_country("US");
+		login.set_level(1);
+		m_state = STATE_LOGGING_IN;
+		this->sendPacket(CMSG_PLAYER_LOGIN, login);
+		break;
+	}
+	case AuthVerdict::AUTH_WAIT_QUEUE:
+		// The server sends another verdict when the session leaves the queue
+		break;
+	default:
+		printf("Client %u: authentication failed (result %d)\n", m_index, verdict.result());
+		m_stats.onProtocolError();
+		this->close(false);
+		break;
+	}
+}
+
+void LoadClient::handleTheaterInfo(LoadPacket& /*packet*/)
+{
+	m_stats.addLoginLatency(getSteadyTimeMicros() - m_authStartTime);
+
+	JoinTheater join;
+	m_state = STATE_JOINING;
+	this->sendPacket(CMSG_JOIN_THEATER, join);
+}
+
+void LoadClient::handleUpdateObject(LoadPacket& packet)
+{
+	uint8 const* body = packet.getBodyData();
+	if (packet.getFrameCount() > 1)
+	{
+		// The scan needs the body of a streamed packet in one piece
+		m_scanBuffer.clear();
+		for (uint32 i = 0; i < packet.getFrameCount(); ++i)
+			m_scanBuffer.insert(m_scanBuffer.end(), packet.getFrameBodyData(i), packet.getFrameBodyData(i) + packet.getFrameBodyBytes(i));
+		body = m_scanBuffer.data();
+	}
+
+	MovementInfo movement;
+	if (!findSelfMovement(body, packet.getBodyBytes(), movement))
+		return;
+
+	// The character was spawned or reset, the script continues from the position of the server
+	m_movement = movement;
+	m_movement.flags = 0;
+	m_moveStep = 0;
+
+	if (m_state != STATE_IN_BATTLE)
+	{
+		m_state = STATE_IN_BATTLE;
+		m_stats.onEnteredBattle();
+
+		int64 now = getSteadyTimeMicros();
+		m_nextMoveTime = now;
+		m_nextAttackTime = now + m_settings.attackInterval * 1000LL;
+		m_nextUseItemTime = now + m_settings.useItemInterval * 1000LL;
+		this->scheduleAction();
+	}
+}
+
+void LoadClient::handleTimeSyncReq(LoadPacket& packet)
+{
+	TimeSyncReq request;
+	packet.unpack(request);
+
+	TimeSyncResp response;
+	response.set_counter(request.counter());
+	response.set_time(getClientTimeMillis());
+	this->sendPacket(CMSG_TIME_SYNC_RESP, response);
+
+	m_isTimeSynced = true;
+}
+
+void LoadClient::handlePong(LoadPacket& packet)
+{
+	Pong pong;
+	packet.unpack(pong);
+
+	if (pong.counter() != m_pingCounter || m_pingSentTime == 0)
+		return;
+
+	int64 latency = getSteadyTimeMicros() - m_pingSentTime;
+	m_pingSentTime = 0;
+	m_lastPingLatency = static_cast<int32>(latency / 1000);
+	m_stats.addPingLatency(latency);
+}
+
+void LoadClient::handleMovement(LoadPacket& packet)
+{
+	// The server sets the time of each movement packet to its estimate of the receiver's clock
+	// when the packet is built in the world tick, so the difference is the tick-to-receive delay
+	if (!m_isTimeSynced)
+		return;
+
+	MovementInfo movement;
+	packet.unpack(movement);
+
+	int64 delay = static_cast<int64>(getClientTimeMillis()) - movement.time;
+	m_stats.addTickLatency(std::max<int64>(delay, 0) * 1000);
+}
+
+void LoadClient::handleBattleResult(LoadPacket& /*packet*/)
+{
+	m_stats.onBattleEnded();
+	if (!m_settings.rejoin)
+	{
+		m_actionTimer.cancel();
+		return;
+	}
+
+	this->close(false);
+
+	auto self(this->shared_from_this());
+	m_reconnectTimer.expires_from_now(std::chrono::milliseconds(REJOIN_DELAY));
+	m_reconnectTimer.async_wait(m_strand.wrap([this, self](boost::system::error_code const& error)
+	{
+		if (!error)
+			this->connect();
+	}));
+}
+
+void LoadClient::scheduleAction()
+{
+	int64 next = m_nextPingTime;
+	if (m_state == STATE_IN_BATTLE)
+	{
+		next = std::min(next, m_nextMoveTime);
+		if (m_settings.attackInterval > 0)
+			next = std::min(next, m_nextAttackTime);
+		if (m_settings.useItemInterval > 0)
+			next = std::min(next, m_nextUseItemTime);
+	}
+
+	int64 delay = std::max<int64>(next - getSteadyTimeMicros(), 0);
+
+	auto self(this->shared_from_this());
+	m_actionTimer.expires_from_now(std::chrono::microseconds(delay));
+	m_actionTimer.async_wait(m_strand.wrap([this, self](boost::system::error_code const& error)
+	{
+		if (!error && m_state != STATE_IDLE)
+			this->runActions();
+	}));
+}
+
+void LoadClient::runActions()
+{
+	int64 now = getSteadyTimeMicros();
+	bool isInBattle = m_state == STATE_IN_BATTLE;
+
+	if (isInBattle && now >= m_nextMoveTime)
+	{
+		// Walk back and forth: start a leg, send a heartbeat for each step, stop and turn around
+		if (m_moveStep == 0)
+		{
+			m_movement.flags = MOVEMENT_FLAG_WALKING;
+			this->sendMovement(MSG_MOVE_START);
+		}
+		else
+		{
+			m_movement.position.x += std::cos(m_movement.orientation) * m_settings.stepLength;
+			m_movement.position.y += std::sin(m_movement.orientation) * m_settings.stepLength;
+
+			if (m_moveStep < m_settings.legLength)
+				this->sendMovement(MSG_MOVE_HEARTBEAT);
+			else
+			{
+				m_movement.flags = 0;
+				this->sendMovement(MSG_MOVE_STOP);
+
+				m_movement.orientation += static_cast<float>(M_PI);
+				if (m_movement.orientation > static_cast<float>(M_PI))
+					m_movement.orientation -= static_cast<float>(2 * M_PI);
+				m_moveStep = -1;
+			}
+		}
+
+		++m_moveStep;
+		m_nextMoveTime = now + m_settings.moveInterval * 1000LL;
+	}
+
+	if (isInBattle && m_settings.attackInterval > 0 && now >= m_nextAttackTime)
+	{
+		this->sendAttack();
+		m_nextAttackTime = now + m_settings.attackInterval * 1000LL;
+	}
+
+	if (isInBattle && m_settings.useItemInterval > 0 && now >= m_nextUseItemTime)
+	{
+		this->sendUseItem();
+		m_nextUseItemTime = now + m_settings.useItemInterval * 1000LL;
+	}
+
+	if (now >= m_nextPingTime)
+	{
+		this->sendPing();
+		m_nextPingTime = now + m_settings.pingInterval * 1000LL;
+	}
+
+	this->scheduleAction();
+}
+
+void LoadClient::sendMovement(uint16 opcode)
+{
+	m_movement.time = getClientTimeMillis();
+	this->sendPacket(opcode, m_movement);
+}
+
+void LoadClient::sendAttack()
+{
+	AttackInfo attack;
+	attack.set_launcher(m_movement.guid.getRawValue());
+	attack.set_direction(m_movement.orientation);
+	attack.set_counter(++m_attackCounter);
+	attack.set_movement_counter(m_movement.counter);
+	this->sendPacket(CMSG_ATTACK, attack);
+}
+
+void LoadClient::sendUseItem()
+{
+	// The inventory is not tracked, so the request exercises the handler and is answered with a failed result
+	// unless the character happens to carry an item in the first slot
+	UseItem useItem;
+	useItem.set_slot(0);
+	useItem.set_item(0);
+	this->sendPacket(CMSG_USE_ITEM, useItem);
+}
+
+void LoadClient::sendPing()
+{
+	Ping ping;
+	ping.set_counter(++m_pingCounter);
+	ping.set_latency(m_lastPingLatency);
+	m_pingSentTime = getSteadyTimeMicros();
+	this->sendPacket(MSG_PING, ping);
+}
+
+void LoadClient::sendPacket(uint16 opcode, MessageLite const& message)
+{
+	LoadPacket packet(opcode);
+	packet.pack(message);
+	packet.encodeHeader();
+
+	uint8 const* header = packet.getHeaderPointer();
+	m_writeQueue.insert(m_writeQueue.end(), header, header + LoadPacket::HEADER_BYTE_SIZE);
+	if (packet.hasBody())
+		m_writeQueue.insert(m_writeQueue.end(), packet.getBodyData(), packet.getBodyData() + packet.getBodyBytes());
+	m_stats.addSent(packet.getByteSize());
+
+	this->flushWrites();
+}
+
+void LoadClient::flushWrites()
+{
+	if (m_isWriting || m_writeQueue.empty())
+		return;
+
+	// Packets queued while a write is in progress are sent with the next write
+	m_writeBuffer.swap(m_writeQueue);
+	m_writeQueue.clear();
+	m_isWriting = true;
+
+	auto self(this->shared_from_this());
+	boost::asio::async_write(m_socket, boost::asio::buffer(m_writeBuffer),
+		m_strand.wrap([this, self](boost::system::error_code const& error, std::size_t /*transferredBytes*/)
+	{
+		m_isWriting = false;
+		if (m_state == STATE_IDLE)
+			return;
+
+		if (error)
+		{
+			this->close(true);
+			return;
+		}
+
+		this->flushWrites();
+	}));
+}
+
+int32 LoadClient::getClientTimeMillis()
+{
+	return static_cast<int32>(getUptimeMillis());
+}
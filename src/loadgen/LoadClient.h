@@ -0,0 +1,135 @@
+#ifndef __LOAD_CLIENT_H__
+#define __LOAD_CLIENT_H__
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "Common.h"
+#include "networking/BasicPacket.h"
+#include "game/server/protocol/Opcode.h"
+#include "game/entities/MovementInfo.h"
+
+#include "LoadStats.h"
+
+typedef BasicPacket<NUM_MSG_TYPES> LoadPacket;
+
+struct LoadSettings
+{
+	boost::asio::ip::tcp::endpoint endpoint;
+	// Character template id sent in CMSG_PLAYER_LOGIN
+	uint32 charId;
+	// Interval of the movement script. A leg is started, continued with heartbeats and stopped at this interval
+	int32 moveInterval;
+	// Number of move intervals before the client turns around
+	int32 legLength;
+	// Distance moved in each move interval
+	float stepLength;
+	// Interval of CMSG_ATTACK and CMSG_USE_ITEM, 0 disables the action
+	int32 attackInterval;
+	int32 useItemInterval;
+	// Interval of MSG_PING, which also keeps the session from timing out
+	int32 pingInterval;
+	// Reconnect and join a new battle when the battle ends
+	bool rejoin;
+	// Sets REQUIRES_STREAMING in the auth proof
+	bool streaming;
+	// Stay connected after the auth verdict instead of logging in, to measure the accept path of the server
+	bool authOnly;
+	// Send UDP time queries to ntsserver instead of running game clients, see UdpTimeClient
+	bool udpTime;
+	boost::asio::ip::udp::endpoint udpEndpoint;
+	// Number of time queries each UDP client keeps in flight
+	int32 udpWindow;
+};
+
+// A simulated game client. It logs in and joins a theater like the real client, then
+// runs a movement, attack and item-use script once its character has spawned.
+// All handlers of a client run on its strand, so the io_service may be run by several threads
+class LoadClient : public std::enable_shared_from_this<LoadClient>
+{
+public:
+	enum
+	{
+		READ_BUFFER_SIZE = 16 * 1024
+	};
+
+	enum ClientState
+	{
+		STATE_IDLE,
+		STATE_CONNECTING,
+		STATE_AUTHENTICATING,
+		STATE_LOGGING_IN,
+		STATE_JOINING,
+		STATE_IN_BATTLE
+	};
+
+	LoadClient(boost::asio::io_service& service, LoadSettings const& settings, LoadStats& stats, uint32 index);
+
+	void start();
+	void stop();
+
+private:
+	void connect();
+	// Close the connection. byServer is true if the server closed it or the connection failed
+	void close(bool byServer);
+
+	void readSome();
+	bool parseReadBuffer();
+	void handlePacket(LoadPacket& packet);
+
+	void handleAuthVerdict(LoadPacket& packet);
+	void handleTheaterInfo(LoadPacket& packet);
+	void handleUpdateObject(LoadPacket& packet);
+	void handleTimeSyncReq(LoadPacket& packet);
+	void handlePong(LoadPacket& packet);
+	void handleMovement(LoadPacket& packet);
+	void handleBattleResult(LoadPacket& packet);
+
+	void scheduleAction();
+	void runActions();
+	void sendMovement(uint16 opcode);
+	void sendAttack();
+	void sendUseItem();
+	void sendPing();
+
+	void sendPacket(uint16 opcode, MessageLite const& message);
+	void flushWrites();
+
+	// Client clock sent in time syncs. The server stamps the packets it sends with this clock
+	static int32 getClientTimeMillis();
+
+	boost::asio::io_service::strand m_strand;
+	boost::asio::ip::tcp::socket m_socket;
+	boost::asio::steady_timer m_actionTimer;
+	boost::asio::steady_timer m_reconnectTimer;
+	LoadSettings const& m_settings;
+	LoadStats& m_stats;
+	uint32 const m_index;
+
+	ClientState m_state;
+	bool m_isStopped;
+	int64 m_connectStartTime;
+	int64 m_authStartTime;
+
+	MessageBuffer m_readBuffer;
+	// The frames received so far of a streamed packet
+	LoadPacket m_streamPacket;
+	std::vector<uint8> m_scanBuffer;
+	std::vector<uint8> m_writeBuffer;
+	std::vector<uint8> m_writeQueue;
+	bool m_isWriting;
+
+	bool m_isTimeSynced;
+	MovementInfo m_movement;
+	int32 m_moveStep;
+	uint32 m_attackCounter;
+	int64 m_nextMoveTime;
+	int64 m_nextAttackTime;
+	int64 m_nextUseItemTime;
+	int64 m_nextPingTime;
+	int32 m_pingCounter;
+	int64 m_pingSentTime;
+	int32 m_lastPingLatency;
+};
+
+#endif // __LOAD_CLIENT_H__
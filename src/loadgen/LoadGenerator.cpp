@@ -0,0 +1,235 @@
+#include "LoadGenerator.h"
+
+#include <iostream>
+
+#include <boost/asio/signal_set.hpp>
+
+#include "utilities/TimeUtil.h"
+
+using namespace boost::program_options;
+
+// Delay between stopping the clients and stopping the io_service, so that the connections are closed cleanly. Unit: milliseconds
+#define STOP_DELAY				500
+
+LoadGenerator::LoadGenerator() :
+	m_strand(m_ioService),
+	m_rampTimer(m_ioService),
+	m_reportTimer(m_ioService),
+	m_durationTimer(m_ioService),
+	m_stopTimer(m_ioService),
+	m_isFinished(false),
+	m_port(0),
+	m_connectionCount(0),
+	m_connectRate(0),
+	m_duration(0),
+	m_threadCount(0),
+	m_reportInterval(0),
+	m_startTime(0),
+	m_lastReportTime(0)
+{
+}
+
+LoadGenerator::~LoadGenerator()
+{
+}
+
+LoadGenerator* LoadGenerator::instance()
+{
+	static LoadGenerator instance;
+	return &instance;
+}
+
+int LoadGenerator::run(int argc, char** argv)
+{
+	try
+	{
+		if (!this->parseCommandLine(argc, argv))
+			return EXIT_SUCCESS;
+	}
+	catch (std::exception const& e)
+	{
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	boost::system::error_code ec;
+	boost::asio::ip::address address = boost::asio::ip::address::from_string(m_host, ec);
+	if (ec)
+	{
+		printf("Invalid address %s: %s\n", m_host.c_str(), ec.message().c_str());
+		return EXIT_FAILURE;
+	}
+
+	// The generated traffic is meant for a local server only
+	if (!address.is_loopback())
+	{
+		printf("Address %s is not a loopback address.\n", m_host.c_str());
+		return EXIT_FAILURE;
+	}
+
+	m_settings.endpoint = boost::asio::ip::tcp::endpoint(address, m_port);
+	m_settings.udpEndpoint = boost::asio::ip::udp::endpoint(address, m_port);
+
+	if (m_settings.udpTime)
+		printf("Sending UDP time queries from %d clients with %d queries in flight each to %s:%d with %d thread(s)\n",
+			m_connectionCount, m_settings.udpWindow, m_host.c_str(), m_port, m_threadCount);
+	else
+		printf("Connecting %d clients to %s:%d at %d connections/s with %d thread(s)\n",
+			m_connectionCount, m_host.c_str(), m_port, m_connectRate, m_threadCount);
+	fflush(stdout);
+
+	boost::asio::signal_set signals(m_ioService, SIGINT, SIGTERM);
+	signals.async_wait([this](boost::system::error_code const& error, int /*signalNumber*/) {
+		if (!error)
+			this->finish();
+	});
+
+	m_startTime = getSteadyTimeMicros();
+	m_lastReportTime = m_startTime;
+
+	if (m_settings.udpTime)
+		m_udpClients.reserve(m_connectionCount);
+	else
+		m_clients.reserve(m_connectionCount);
+	m_strand.post([this]() {
+		this->startNextClient();
+		this->scheduleReport();
+	});
+
+	if (m_duration > 0)
+	{
+		m_durationTimer.expires_from_now(std::chrono::seconds(m_duration));
+		m_durationTimer.async_wait([this](boost::system::error_code const& error) {
+			if (!error)
+				this->finish();
+		});
+	}
+
+	for (int32 i = 1; i < m_threadCount; ++i)
+		m_threadPool.emplace_back([this]() { m_ioService.run(); });
+	m_ioService.run();
+
+	for (auto& thread : m_threadPool)
+		thread.join();
+	m_threadPool.clear();
+
+	m_stats.reportSummary((getSteadyTimeMicros() - m_startTime) / 1000000.0);
+
+	return EXIT_SUCCESS;
+}
+
+bool LoadGenerator::parseCommandLine(int argc, char** argv)
+{
+	options_description desc("Allowed options");
+	desc.add_options()
+		("help,h", "print usage message")
+		("host", value<std::string>(&m_host)->default_value("127.0.0.1"), "loopback address of the worldserver")
+		("port,p", value<uint16>(&m_port)->default_value(18402), "port of the worldserver")
+		("connections,n", value<int32>(&m_connectionCount)->default_value(100), "number of clients")
+		("connect-rate", value<int32>(&m_connectRate)->default_value(50), "clients connected per second")
+		("duration,d", value<int32>(&m_duration)->default_value(60), "seconds to run, 0 runs until interrupted")
+		("threads,t", value<int32>(&m_threadCount)->default_value(1), "number of network threads")
+		("report-interval", value<int32>(&m_reportInterval)->default_value(5), "seconds between progress reports")
+		("char-id", value<uint32>(&m_settings.charId)->default_value(1), "character template id used to log in")
+		("move-interval", value<int32>(&m_settings.moveInterval)->default_value(200), "milliseconds between movement packets")
+		("leg-length", value<int32>(&m_settings.legLength)->default_value(10), "movement packets before turning around")
+		("step-length", value<float>(&m_settings.stepLength)->default_value(10.f), "distance moved per movement packet")
+		("attack-interval", value<int32>(&m_settings.attackInterval)->default_value(1000), "milliseconds between attacks, 0 disables attacks")
+		("use-item-interval", value<int32>(&m_settings.useItemInterval)->default_value(5000), "milliseconds between item uses, 0 disables item uses")
+		("ping-interval", value<int32>(&m_settings.pingInterval)->default_value(3000), "milliseconds between pings")
+		("no-rejoin", "do not join a new battle when the battle ends")
+		("no-streaming", "do not accept packets streamed across continuation frames")
+		("auth-only", "stay connected after authenticating instead of logging in, to measure the accept rate")
+		("udp-time", "send UDP time queries to the ntsserver on --port instead of running game clients")
+		("udp-window", value<int32>(&m_settings.udpWindow)->default_value(16), "time queries each UDP client keeps in flight");
+
+	variables_map vm;
+	store(command_line_parser(argc, argv).options(desc).run(), vm);
+	notify(vm);
+
+	if (vm.count("help"))
+	{
+		std::cout << desc << "\n";
+		return false;
+	}
+
+	m_settings.rejoin = vm.count("no-rejoin") == 0;
+	m_settings.streaming = vm.count("no-streaming") == 0;
+	m_settings.authOnly = vm.count("auth-only") > 0;
+	m_settings.udpTime = vm.count("udp-time") > 0;
+	m_settings.udpWindow = std::max(m_settings.udpWindow, 1);
+	m_connectionCount = std::max(m_connectionCount, 0);
+	m_connectRate = std::max(m_connectRate, 1);
+	m_threadCount = std::max(m_threadCount, 1);
+	m_reportInterval = std::max(m_reportInterval, 1);
+	m_settings.moveInterval = std::max(m_settings.moveInterval, 1);
+	m_settings.legLength = std::max(m_settings.legLength, 1);
+	m_settings.pingInterval = std::max(m_settings.pingInterval, 1);
+
+	return true;
+}
+
+void LoadGenerator::startNextClient()
+{
+	if (m_isFinished || static_cast<int32>(m_clients.size() + m_udpClients.size()) >= m_connectionCount)
+		return;
+
+	if (m_settings.udpTime)
+	{
+		std::shared_ptr<UdpTimeClient> client = std::make_shared<UdpTimeClient>(m_ioService, m_settings, m_stats);
+		m_udpClients.push_back(client);
+		client->start();
+	}
+	else
+	{
+		uint32 index = static_cast<uint32>(m_clients.size());
+		std::shared_ptr<LoadClient> client = std::make_shared<LoadClient>(m_ioService, m_settings, m_stats, index);
+		m_clients.push_back(client);
+		client->start();
+	}
+
+	m_rampTimer.expires_from_now(std::chrono::microseconds(1000000 / m_connectRate));
+	m_rampTimer.async_wait(m_strand.wrap([this](boost::system::error_code const& error) {
+		if (!error)
+			this->startNextClient();
+	}));
+}
+
+void LoadGenerator::scheduleReport()
+{
+	m_reportTimer.expires_from_now(std::chrono::seconds(m_reportInterval));
+	m_reportTimer.async_wait(m_strand.wrap([this](boost::system::error_code const& error) {
+		if (error || m_isFinished)
+			return;
+
+		int64 now = getSteadyTimeMicros();
+		m_stats.reportInterval((now - m_lastReportTime) / 1000000.0);
+		m_lastReportTime = now;
+
+		this->scheduleReport();
+	}));
+}
+
+void LoadGenerator::finish()
+{
+	// The clients are started and stopped on the strand of the generator
+	m_strand.post([this]() {
+		if (m_isFinished)
+			return;
+
+		m_isFinished = true;
+		m_rampTimer.cancel();
+		m_reportTimer.cancel();
+		m_durationTimer.cancel();
+
+		for (auto& client : m_clients)
+			client->stop();
+		for (auto& client : m_udpClients)
+			client->stop();
+
+		m_stopTimer.expires_from_now(std::chrono::milliseconds(STOP_DELAY));
+		m_stopTimer.async_wait([this](boost::system::error_code const&) {
+			m_ioService.stop();
+		});
+	});
+}
@@ -0,0 +1,63 @@
+#ifndef __LOAD_GENERATOR_H__
+#define __LOAD_GENERATOR_H__
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/program_options.hpp>
+
+#include "Common.h"
+#include "LoadClient.h"
+#include "LoadStats.h"
+#include "UdpTimeClient.h"
+
+// Headless load generator for worldserver. It opens the configured number of client
+// connections on loopback, logs them in and joins them to theaters, runs the scripted
+// traffic of LoadClient for the configured duration and reports the latencies and bandwidth.
+// With --udp-time the clients are UdpTimeClients that flood the UDP time service of ntsserver instead
+class LoadGenerator
+{
+public:
+	static LoadGenerator* instance();
+
+	int run(int argc, char** argv);
+
+private:
+	LoadGenerator();
+	~LoadGenerator();
+
+	// Returns false if the program should exit without running, e.g. after printing the usage
+	bool parseCommandLine(int argc, char** argv);
+
+	void startNextClient();
+	void scheduleReport();
+	void finish();
+
+	boost::asio::io_service m_ioService;
+	boost::asio::io_service::strand m_strand;
+	boost::asio::steady_timer m_rampTimer;
+	boost::asio::steady_timer m_reportTimer;
+	boost::asio::steady_timer m_durationTimer;
+	boost::asio::steady_timer m_stopTimer;
+	std::vector<std::thread> m_threadPool;
+
+	LoadSettings m_settings;
+	LoadStats m_stats;
+	std::vector<std::shared_ptr<LoadClient>> m_clients;
+	std::vector<std::shared_ptr<UdpTimeClient>> m_udpClients;
+	bool m_isFinished;
+
+	std::string m_host;
+	uint16 m_port;
+	int32 m_connectionCount;
+	int32 m_connectRate;
+	int32 m_duration;
+	int32 m_threadCount;
+	int32 m_reportInterval;
+
+	int64 m_startTime;
+	int64 m_lastReportTime;
+};
+
+#define sLoadGenerator LoadGenerator::instance()
+
+#endif // __LOAD_GENERATOR_H__
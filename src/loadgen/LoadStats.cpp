@@ -0,0 +1,110 @@
+#include "LoadStats.h"
+
+LoadStats::LoadStats() :
+	m_sentBytes(0),
+	m_sentPackets(0),
+	m_receivedBytes(0),
+	m_receivedPackets(0),
+	m_connected(0),
+	m_inBattle(0),
+	m_connectFailures(0),
+	m_serverDisconnects(0),
+	m_battlesEnded(0),
+	m_protocolErrors(0),
+	m_lostTimeQueries(0),
+	m_firstConnectTime(0),
+	m_lastAuthTime(0),
+	m_lastSentBytes(0),
+	m_lastReceivedBytes(0),
+	m_lastReceivedPackets(0)
+{
+}
+
+void LoadStats::onDisconnected(bool byServer, bool wasInBattle)
+{
+	if (byServer)
+		m_serverDisconnects.fetch_add(1, std::memory_order_relaxed);
+	m_connected.fetch_sub(1, std::memory_order_relaxed);
+	if (wasInBattle)
+		m_inBattle.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void LoadStats::addAuthLatency(int64 connectStartTime, int64 now)
+{
+	m_authLatency.add(now - connectStartTime);
+
+	int64 first = m_firstConnectTime.load(std::memory_order_relaxed);
+	while ((first == 0 || connectStartTime < first) && !m_firstConnectTime.compare_exchange_weak(first, connectStartTime, std::memory_order_relaxed))
+		;
+
+	int64 last = m_lastAuthTime.load(std::memory_order_relaxed);
+	while (now > last && !m_lastAuthTime.compare_exchange_weak(last, now, std::memory_order_relaxed))
+		;
+}
+
+void LoadStats::reportInterval(double elapsedSeconds)
+{
+	uint64 sentBytes = m_sentBytes.load(std::memory_order_relaxed);
+	uint64 receivedBytes = m_receivedBytes.load(std::memory_order_relaxed);
+	uint64 receivedPackets = m_receivedPackets.load(std::memory_order_relaxed);
+
+	double seconds = std::max(elapsedSeconds, 0.001);
+	printf("connected: %d, in battle: %d, disconnects: %u | tx: %.1f KB/s, rx: %.1f KB/s, %.0f pkt/s | tick latency p50: %.2f ms, p99: %.2f ms\n",
+		m_connected.load(std::memory_order_relaxed),
+		m_inBattle.load(std::memory_order_relaxed),
+		m_serverDisconnects.load(std::memory_order_relaxed),
+		(sentBytes - m_lastSentBytes) / 1024.0 / seconds,
+		(receivedBytes - m_lastReceivedBytes) / 1024.0 / seconds,
+		(receivedPackets - m_lastReceivedPackets) / seconds,
+		m_tickLatency.getPercentile(50) / 1000.0,
+		m_tickLatency.getPercentile(99) / 1000.0);
+	fflush(stdout);
+
+	m_lastSentBytes = sentBytes;
+	m_lastReceivedBytes = receivedBytes;
+	m_lastReceivedPackets = receivedPackets;
+}
+
+void LoadStats::reportSummary(double elapsedSeconds) const
+{
+	double seconds = std::max(elapsedSeconds, 0.001);
+	uint64 sentBytes = m_sentBytes.load(std::memory_order_relaxed);
+	uint64 receivedBytes = m_receivedBytes.load(std::memory_order_relaxed);
+
+	printf("\n==== Summary (%.1f s) ====\n", elapsedSeconds);
+	printLatency("connect", m_connectLatency);
+	printLatency("accept-to-auth", m_authLatency);
+	printLatency("login", m_loginLatency);
+	printLatency("tick-to-receive", m_tickLatency);
+	printLatency("ping", m_pingLatency);
+	printLatency("udp time query", m_timeQueryLatency);
+	uint64 authCount = m_authLatency.getCount();
+	double authSeconds = (m_lastAuthTime.load(std::memory_order_relaxed) - m_firstConnectTime.load(std::memory_order_relaxed)) / 1000000.0;
+	printf("accept rate: %llu connections authenticated in %.3f s (%.0f connections/s)\n",
+		(unsigned long long)authCount, authSeconds, authSeconds > 0 ? authCount / authSeconds : 0.0);
+	uint64 timeQueryCount = m_timeQueryLatency.getCount();
+	printf("udp time queries: %llu answered (%.0f queries/s), %llu lost\n",
+		(unsigned long long)timeQueryCount, timeQueryCount / seconds, (unsigned long long)m_lostTimeQueries.load(std::memory_order_relaxed));
+	printf("sent: %llu packets, %llu bytes (%.1f KB/s)\n",
+		(unsigned long long)m_sentPackets.load(std::memory_order_relaxed), (unsigned long long)sentBytes, sentBytes / 1024.0 / seconds);
+	printf("received: %llu packets, %llu bytes (%.1f KB/s)\n",
+		(unsigned long long)m_receivedPackets.load(std::memory_order_relaxed), (unsigned long long)receivedBytes, receivedBytes / 1024.0 / seconds);
+	printf("battles ended: %u, connect failures: %u, server disconnects: %u, protocol errors: %u\n",
+		m_battlesEnded.load(std::memory_order_relaxed),
+		m_connectFailures.load(std::memory_order_relaxed),
+		m_serverDisconnects.load(std::memory_order_relaxed),
+		m_protocolErrors.load(std::memory_order_relaxed));
+	fflush(stdout);
+}
+
+void LoadStats::printLatency(char const* name, Histogram const& histogram)
+{
+	printf("%-16s samples: %llu, mean: %.2f ms, p50: %.2f ms, p90: %.2f ms, p99: %.2f ms, max: %.2f ms\n",
+		name,
+		(unsigned long long)histogram.getCount(),
+		histogram.getMean() / 1000.0,
+		histogram.getPercentile(50) / 1000.0,
+		histogram.getPercentile(90) / 1000.0,
+		histogram.getPercentile(99) / 1000.0,
+		histogram.getMax() / 1000.0);
+}
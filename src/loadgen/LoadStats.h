@@ -0,0 +1,75 @@
+#ifndef __LOAD_STATS_H__
+#define __LOAD_STATS_H__
+
+#include <atomic>
+
+#include "Common.h"
+#include "utilities/Histogram.h"
+
+// Counters shared by all the simulated clients. Latencies are in microseconds
+class LoadStats
+{
+public:
+	LoadStats();
+
+	void addConnectLatency(int64 micros) { m_connectLatency.add(micros); }
+	void addLoginLatency(int64 micros) { m_loginLatency.add(micros); }
+	// Called with the start time of the connect when the auth verdict of a connection is received
+	void addAuthLatency(int64 connectStartTime, int64 now);
+	// The delay between the server stamping a movement packet in its tick and the client receiving it
+	void addTickLatency(int64 micros) { m_tickLatency.add(micros); }
+	void addPingLatency(int64 micros) { m_pingLatency.add(micros); }
+	// The round trip of a UDP time query, see UdpTimeClient
+	void addTimeQueryLatency(int64 micros) { m_timeQueryLatency.add(micros); }
+
+	void addSent(uint32 bytes) { m_sentBytes.fetch_add(bytes, std::memory_order_relaxed); m_sentPackets.fetch_add(1, std::memory_order_relaxed); }
+	void addReceived(uint32 bytes) { m_receivedBytes.fetch_add(bytes, std::memory_order_relaxed); m_receivedPackets.fetch_add(1, std::memory_order_relaxed); }
+
+	void onConnected() { m_connected.fetch_add(1, std::memory_order_relaxed); }
+	void onConnectFailed() { m_connectFailures.fetch_add(1, std::memory_order_relaxed); }
+	void onEnteredBattle() { m_inBattle.fetch_add(1, std::memory_order_relaxed); }
+	void onBattleEnded() { m_battlesEnded.fetch_add(1, std::memory_order_relaxed); }
+	// byServer is true if the server closed the connection or it failed, false if the client closed it
+	void onDisconnected(bool byServer, bool wasInBattle);
+	void onProtocolError() { m_protocolErrors.fetch_add(1, std::memory_order_relaxed); }
+	void onTimeQueriesLost(int32 count) { m_lostTimeQueries.fetch_add(count, std::memory_order_relaxed); }
+
+	// Print the traffic since the previous report
+	void reportInterval(double elapsedSeconds);
+	// Print the totals of the whole run
+	void reportSummary(double elapsedSeconds) const;
+
+private:
+	static void printLatency(char const* name, Histogram const& histogram);
+
+	Histogram m_connectLatency;
+	Histogram m_loginLatency;
+	Histogram m_authLatency;
+	Histogram m_tickLatency;
+	Histogram m_pingLatency;
+	Histogram m_timeQueryLatency;
+
+	std::atomic<uint64> m_sentBytes;
+	std::atomic<uint64> m_sentPackets;
+	std::atomic<uint64> m_receivedBytes;
+	std::atomic<uint64> m_receivedPackets;
+
+	std::atomic<int32> m_connected;
+	std::atomic<int32> m_inBattle;
+	std::atomic<uint32> m_connectFailures;
+	std::atomic<uint32> m_serverDisconnects;
+	std::atomic<uint32> m_battlesEnded;
+	std::atomic<uint32> m_protocolErrors;
+	std::atomic<uint64> m_lostTimeQueries;
+
+	// The first connect and the last auth verdict, the accept rate is measured between them
+	std::atomic<int64> m_firstConnectTime;
+	std::atomic<int64> m_lastAuthTime;
+
+	// Totals at the previous interval report
+	uint64 m_lastSentBytes;
+	uint64 m_lastReceivedBytes;
+	uint64 m_lastReceivedPackets;
+};
+
+#endif // __LOAD_STATS_H__
@@ -0,0 +1,6 @@
+#include "LoadGenerator.h"
+
+int main(int argc, char** argv)
+{
+	return LoadGenerator::instance()->run(argc, argv);
+}
@@ -0,0 +1,140 @@
+#include "UdpTimeClient.h"
+
+#include "utilities/TimeUtil.h"
+
+UdpTimeClient::UdpTimeClient(boost::asio::io_service& service, LoadSettings const& settings, LoadStats& stats) :
+	m_strand(service),
+	m_socket(service),
+	m_lossTimer(service),
+	m_settings(settings),
+	m_stats(stats),
+	m_isStopped(false),
+	m_inFlight(0),
+	m_resultCount(0),
+	m_lastResultCount(0)
+{
+}
+
+void UdpTimeClient::start()
+{
+	auto self(this->shared_from_this());
+	m_strand.post([this, self]() {
+		boost::system::error_code ec;
+		m_socket.connect(m_settings.udpEndpoint, ec);
+		if (ec)
+		{
+			m_stats.onConnectFailed();
+			return;
+		}
+
+		m_stats.onConnected();
+		this->receive();
+		while (m_inFlight < m_settings.udpWindow)
+			this->sendQuery();
+		this->scheduleLossCheck();
+	});
+}
+
+void UdpTimeClient::stop()
+{
+	auto self(this->shared_from_this());
+	m_strand.post([this, self]() {
+		if (m_isStopped)
+			return;
+
+		m_isStopped = true;
+		m_lossTimer.cancel();
+		if (m_socket.is_open())
+		{
+			boost::system::error_code ec;
+			m_socket.close(ec);
+			m_stats.onDisconnected(false, false);
+		}
+	});
+}
+
+void UdpTimeClient::receive()
+{
+	auto self(this->shared_from_this());
+	m_socket.async_receive(boost::asio::buffer(m_receiveBuffer),
+		m_strand.wrap([this, self](boost::system::error_code const& error, std::size_t transferredBytes)
+	{
+		if (m_isStopped)
+			return;
+
+		// An ICMP port unreachable of an earlier query is reported by the next receive, the server may not be up yet
+		if (!error)
+			this->handleResult(transferredBytes);
+
+		this->receive();
+	}));
+}
+
+void UdpTimeClient::handleResult(std::size_t size)
+{
+	m_stats.addReceived(static_cast<uint32>(size));
+
+	if (size < HEADER_BYTE_SIZE)
+	{
+		m_stats.onProtocolError();
+		return;
+	}
+
+	uint16 bodySize = static_cast<uint16>(((m_receiveBuffer[0] << 8) & 0xFF00) | (m_receiveBuffer[1] & 0xFF));
+	uint16 opcode = static_cast<uint16>(((m_receiveBuffer[2] << 8) & 0xFF00) | (m_receiveBuffer[3] & 0xFF));
+	if (opcode != SMSG_TIME_RESULT || bodySize != size - HEADER_BYTE_SIZE
+		|| !m_result.ParseFromArray(m_receiveBuffer + HEADER_BYTE_SIZE, bodySize))
+	{
+		m_stats.onProtocolError();
+		return;
+	}
+
+	// The originate timestamp is the steady time at which the query was sent
+	m_stats.addTimeQueryLatency(getSteadyTimeMicros() - m_result.originate_timestamp());
+	++m_resultCount;
+
+	if (m_inFlight > 0)
+		--m_inFlight;
+	while (m_inFlight < m_settings.udpWindow)
+		this->sendQuery();
+}
+
+void UdpTimeClient::sendQuery()
+{
+	m_query.set_transmit_timestamp(getSteadyTimeMicros());
+
+	uint16 bodySize = static_cast<uint16>(m_query.ByteSizeLong());
+	m_sendBuffer[0] = 0xFF & (bodySize >> 8);
+	m_sendBuffer[1] = 0xFF & bodySize;
+	m_sendBuffer[2] = 0xFF & (CMSG_TIME_QUERY >> 8);
+	m_sendBuffer[3] = 0xFF & CMSG_TIME_QUERY;
+	m_query.SerializeWithCachedSizesToArray(m_sendBuffer + HEADER_BYTE_SIZE);
+
+	// A datagram socket does not block on a full send buffer for long, the datagram is dropped instead
+	boost::system::error_code ec;
+	m_socket.send(boost::asio::buffer(m_sendBuffer, HEADER_BYTE_SIZE + bodySize), 0, ec);
+	m_stats.addSent(HEADER_BYTE_SIZE + bodySize);
+	++m_inFlight;
+}
+
+void UdpTimeClient::scheduleLossCheck()
+{
+	m_lossTimer.expires_from_now(std::chrono::milliseconds(LOSS_TIMEOUT));
+	auto self(this->shared_from_this());
+	m_lossTimer.async_wait(m_strand.wrap([this, self](boost::system::error_code const& error) {
+		if (error || m_isStopped)
+			return;
+
+		// No result for a whole timeout means the queries in flight were dropped, e.g. by the rate limit of the server
+		if (m_resultCount == m_lastResultCount && m_inFlight > 0)
+		{
+			m_stats.onTimeQueriesLost(m_inFlight);
+			m_inFlight = 0;
+			while (m_inFlight < m_settings.udpWindow)
+				this->sendQuery();
+		}
+		m_lastResultCount = m_resultCount;
+
+		this->scheduleLossCheck();
+	}));
+}
@@ -0,0 +1,59 @@
+#ifndef __UDP_TIME_CLIENT_H__
+#define __UDP_TIME_CLIENT_H__
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "Common.h"
+#include "server/protocol/pb/TimeQuery.pb.h"
+#include "server/protocol/pb/TimeResult.pb.h"
+
+#include "LoadClient.h"
+#include "LoadStats.h"
+
+// A simulated client of the UDP time service of ntsserver. It keeps LoadSettings::udpWindow
+// time queries in flight and sends the next query when a result is received, so the
+// throughput is limited by the server. All handlers of a client run on its strand
+class UdpTimeClient : public std::enable_shared_from_this<UdpTimeClient>
+{
+public:
+	enum
+	{
+		// Opcodes of the time service, see src/ntsserver/server/protocol/Opcode.h
+		CMSG_TIME_QUERY = 0x0001,
+		SMSG_TIME_RESULT = 0x0002,
+		HEADER_BYTE_SIZE = 4,
+		MAX_DATAGRAM_SIZE = 256,
+		// Queries without a result after this time (in milliseconds) are counted as lost and sent again
+		LOSS_TIMEOUT = 200
+	};
+
+	UdpTimeClient(boost::asio::io_service& service, LoadSettings const& settings, LoadStats& stats);
+
+	void start();
+	void stop();
+
+private:
+	void receive();
+	void handleResult(std::size_t size);
+	void sendQuery();
+	void scheduleLossCheck();
+
+	boost::asio::io_service::strand m_strand;
+	boost::asio::ip::udp::socket m_socket;
+	boost::asio::steady_timer m_lossTimer;
+	LoadSettings const& m_settings;
+	LoadStats& m_stats;
+
+	bool m_isStopped;
+	int32 m_inFlight;
+	uint64 m_resultCount;
+	uint64 m_lastResultCount;
+
+	TimeQuery m_query;
+	TimeResult m_result;
+	uint8 m_sendBuffer[MAX_DATAGRAM_SIZE];
+	uint8 m_receiveBuffer[MAX_DATAGRAM_SIZE];
+};
+
+#endif // __UDP_TIME_CLIENT_H__
@@ -8,6 +8,7 @@
 #include "logging/Log.h"
 #include "utilities/Util.h"
 #include "server/NTSSocketMgr.h"
+#include "server/NTSUdpServer.h"
 
 #define DEFAULT_CONFIG_FILE     "ntsserver.conf"
 #define DEFAULT_LOG_DIR         "log"
@@ -172,6 +173,12 @@ int Application::run(int argc, char** argv)
 		RETURN_FAILURE("Failed to start network.");
 	}
 
+	// Start the UDP time service on the same port
+	if (sConfigMgr->getBoolDefault("Network.Udp.Enable", false) && !sNTSUdpServer->start(ntsListener, ntsPort))
+	{
+		RETURN_FAILURE("Failed to start UDP time service.");
+	}
+
 	this->receiveIPCMsg(pid, newPID);
 
 	// Start shutting down the server
@@ -184,6 +191,7 @@ int Application::run(int argc, char** argv)
 
 
 	sNTSSocketMgr->stopNetwork();
+	sNTSUdpServer->stop();
 
 	return EXIT_SUCCESS;
 }
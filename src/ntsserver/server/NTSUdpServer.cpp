@@ -0,0 +1,347 @@
+#include "NTSUdpServer.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <time.h>
+#endif
+
+#include "configuration/Config.h"
+#include "logging/Log.h"
+#include "networking/AdmissionControl.h"
+#include "utilities/TimeUtil.h"
+#include "protocol/Opcode.h"
+#include "NTSSocket.h"
+
+NTSUdpServer::NTSUdpServer() :
+	m_socket(m_ioService),
+	m_thread(nullptr),
+	m_stopped(true),
+	m_rateLimit(0.0),
+	m_rateBurst(0.0),
+	m_lastPurgeTime(0),
+	m_receivedCount(0),
+	m_answeredCount(0),
+	m_rateLimitedCount(0),
+	m_malformedCount(0)
+{
+}
+
+NTSUdpServer::~NTSUdpServer()
+{
+	this->stop();
+}
+
+NTSUdpServer* NTSUdpServer::instance()
+{
+	static NTSUdpServer instance;
+	return &instance;
+}
+
+bool NTSUdpServer::start(std::string const& bindIp, uint16 port)
+{
+	m_rateLimit = std::max(sConfigMgr->getFloatDefault("Network.Udp.RateLimit", 20.f), 0.f);
+	m_rateBurst = std::max(sConfigMgr->getFloatDefault("Network.Udp.RateBurst", 40.f), 1.f);
+
+	boost::system::error_code ec;
+	m_localEndpoint = boost::asio::ip::udp::endpoint(boost::asio::ip::address::from_string(bindIp, ec), port);
+	if (!ec)
+		m_socket.open(m_localEndpoint.protocol(), ec);
+	if (!ec)
+		m_socket.bind(m_localEndpoint, ec);
+	if (ec)
+	{
+		NS_LOG_ERROR("nts.udp", "Failed to open UDP socket on %s:%d. err = %s", bindIp.c_str(), port, ec.message().c_str());
+		return false;
+	}
+
+	m_stopped = false;
+	m_thread = new std::thread(&NTSUdpServer::run, this);
+
+	NS_LOG_INFO("nts.udp", "UDP time service listening on %s:%d", bindIp.c_str(), port);
+
+	return true;
+}
+
+void NTSUdpServer::stop()
+{
+	if (!m_thread)
+		return;
+
+	m_stopped = true;
+
+	// Wake up the thread blocked in receive with an empty datagram
+	boost::asio::ip::address wakeAddress = m_localEndpoint.address();
+	if (wakeAddress.is_unspecified())
+		wakeAddress = m_localEndpoint.address().is_v6() ? boost::asio::ip::address(boost::asio::ip::address_v6::loopback()) : boost::asio::ip::address(boost::asio::ip::address_v4::loopback());
+	boost::system::error_code ec;
+	m_socket.send_to(boost::asio::buffer(&m_stopped, 0), boost::asio::ip::udp::endpoint(wakeAddress, m_localEndpoint.port()), 0, ec);
+
+	m_thread->join();
+	delete m_thread;
+	m_thread = nullptr;
+
+	m_socket.close(ec);
+
+	NS_LOG_INFO("nts.udp", "UDP time service stopped. received: " UI64FMTD ", answered: " UI64FMTD ", rate limited: " UI64FMTD ", malformed: " UI64FMTD,
+		m_receivedCount, m_answeredCount, m_rateLimitedCount, m_malformedCount);
+}
+
+void NTSUdpServer::run()
+{
+#ifdef __linux__
+	this->runBatched();
+#else
+	uint8 recvBuffer[MAX_DATAGRAM_SIZE];
+	uint8 sendBuffer[MAX_RESPONSE_SIZE];
+	while (!m_stopped)
+	{
+		boost::asio::ip::udp::endpoint sender;
+		boost::system::error_code ec;
+		std::size_t size = m_socket.receive_from(boost::asio::buffer(recvBuffer), sender, 0, ec);
+		int64 receiveTime = getSystemTimeMillis();
+		if (ec || m_stopped)
+			continue;
+
+		std::string address;
+		if (sender.address().is_v4())
+		{
+			auto bytes = sender.address().to_v4().to_bytes();
+			address.assign(bytes.begin(), bytes.end());
+		}
+		else
+		{
+			// A client usually owns a whole /64 prefix, see AdmissionControl::admit()
+			auto bytes = sender.address().to_v6().to_bytes();
+			address.assign(bytes.begin(), bytes.begin() + AdmissionControl::IPV6_PREFIX_BYTES);
+		}
+
+		int64 originateTime;
+		if (!this->handleQuery(recvBuffer, size, address, getSteadyTimeMicros(), originateTime))
+			continue;
+
+		std::size_t responseSize = this->writeResult(sendBuffer, originateTime, receiveTime, getSystemTimeMillis());
+		m_socket.send_to(boost::asio::buffer(sendBuffer, responseSize), sender, 0, ec);
+		if (!ec)
+			++m_answeredCount;
+	}
+#endif
+}
+
+#ifdef __linux__
+void NTSUdpServer::runBatched()
+{
+	int fd = m_socket.native_handle();
+
+	// The kernel records the arrival time of each datagram, so the receive timestamp
+	// does not include the time the datagram waited in the socket buffer
+	int enable = 1;
+	bool hasKernelTimestamps = setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+	if (!hasKernelTimestamps)
+		NS_LOG_WARN("nts.udp", "SO_TIMESTAMPNS is not supported, receive timestamps are taken after the datagrams are read");
+
+	std::vector<uint8> recvBuffers(BATCH_SIZE * MAX_DATAGRAM_SIZE);
+	std::vector<uint8> sendBuffers(BATCH_SIZE * MAX_RESPONSE_SIZE);
+	std::vector<char> controls(BATCH_SIZE * CMSG_SPACE(sizeof(struct timespec)));
+	struct sockaddr_storage addrs[BATCH_SIZE];
+	struct iovec recvIovs[BATCH_SIZE];
+	struct iovec sendIovs[BATCH_SIZE];
+	struct mmsghdr recvMsgs[BATCH_SIZE];
+	struct mmsghdr sendMsgs[BATCH_SIZE];
+	int64 originateTimes[BATCH_SIZE];
+	int64 receiveTimes[BATCH_SIZE];
+
+	std::memset(recvMsgs, 0, sizeof(recvMsgs));
+	std::memset(sendMsgs, 0, sizeof(sendMsgs));
+	for (int32 i = 0; i < BATCH_SIZE; ++i)
+	{
+		recvIovs[i].iov_base = &recvBuffers[i * MAX_DATAGRAM_SIZE];
+		recvIovs[i].iov_len = MAX_DATAGRAM_SIZE;
+		recvMsgs[i].msg_hdr.msg_iov = &recvIovs[i];
+		recvMsgs[i].msg_hdr.msg_iovlen = 1;
+		recvMsgs[i].msg_hdr.msg_name = &addrs[i];
+
+		sendIovs[i].iov_base = &sendBuffers[i * MAX_RESPONSE_SIZE];
+		sendMsgs[i].msg_hdr.msg_iov = &sendIovs[i];
+		sendMsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	std::string address;
+	while (!m_stopped)
+	{
+		for (int32 i = 0; i < BATCH_SIZE; ++i)
+		{
+			recvMsgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			recvMsgs[i].msg_hdr.msg_control = hasKernelTimestamps ? &controls[i * CMSG_SPACE(sizeof(struct timespec))] : nullptr;
+			recvMsgs[i].msg_hdr.msg_controllen = hasKernelTimestamps ? CMSG_SPACE(sizeof(struct timespec)) : 0;
+			recvMsgs[i].msg_hdr.msg_flags = 0;
+		}
+
+		// Block until at least one datagram arrives, then take whatever else is already queued
+		int32 count = recvmmsg(fd, recvMsgs, BATCH_SIZE, MSG_WAITFORONE, nullptr);
+		if (count <= 0)
+		{
+			if (count < 0 && errno != EINTR && errno != EAGAIN)
+				NS_LOG_ERROR("nts.udp", "recvmmsg failed. errno = %d", errno);
+			continue;
+		}
+
+		int64 readTime = getSystemTimeMillis();
+		int64 now = getSteadyTimeMicros();
+		int32 responses = 0;
+		for (int32 i = 0; i < count; ++i)
+		{
+			msghdr& hdr = recvMsgs[i].msg_hdr;
+			if ((hdr.msg_flags & MSG_TRUNC) != 0)
+			{
+				++m_receivedCount;
+				++m_malformedCount;
+				continue;
+			}
+
+			int64 receiveTime = readTime;
+			for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+			{
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+				{
+					struct timespec ts;
+					std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+					receiveTime = int64(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+				}
+			}
+
+			if (addrs[i].ss_family == AF_INET)
+			{
+				sockaddr_in const* addr = reinterpret_cast<sockaddr_in const*>(&addrs[i]);
+				address.assign(reinterpret_cast<char const*>(&addr->sin_addr), sizeof(addr->sin_addr));
+			}
+			else
+			{
+				sockaddr_in6 const* addr = reinterpret_cast<sockaddr_in6 const*>(&addrs[i]);
+				// A client usually owns a whole /64 prefix, see AdmissionControl::admit()
+				address.assign(reinterpret_cast<char const*>(&addr->sin6_addr), AdmissionControl::IPV6_PREFIX_BYTES);
+			}
+
+			if (!this->handleQuery(&recvBuffers[i * MAX_DATAGRAM_SIZE], recvMsgs[i].msg_len, address, now, originateTimes[responses]))
+				continue;
+
+			receiveTimes[responses] = receiveTime;
+			sendMsgs[responses].msg_hdr.msg_name = &addrs[i];
+			sendMsgs[responses].msg_hdr.msg_namelen = hdr.msg_namelen;
+			++responses;
+		}
+
+		if (responses == 0)
+			continue;
+
+		int64 transmitTime = getSystemTimeMillis();
+		for (int32 i = 0; i < responses; ++i)
+			sendIovs[i].iov_len = this->writeResult(&sendBuffers[i * MAX_RESPONSE_SIZE], originateTimes[i], receiveTimes[i], transmitTime);
+
+		int32 sent = 0;
+		while (sent < responses)
+		{
+			int32 result = sendmmsg(fd, sendMsgs + sent, responses - sent, 0);
+			if (result < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				// The remaining responses are lost, the clients will retry
+				NS_LOG_DEBUG("nts.udp", "sendmmsg failed. errno = %d", errno);
+				break;
+			}
+			sent += result;
+		}
+		m_answeredCount += sent;
+	}
+}
+#endif
+
+bool NTSUdpServer::handleQuery(uint8 const* data, std::size_t size, std::string const& address, int64 now, int64& originateTimestamp)
+{
+	// An empty datagram is the wake-up sent by stop()
+	if (size == 0)
+		return false;
+
+	++m_receivedCount;
+
+	if (size < NTSPacket::HEADER_BYTE_SIZE)
+	{
+		++m_malformedCount;
+		return false;
+	}
+
+	uint16 bodySize = NTSPacket::peekBodyBytes(data);
+	uint16 opcode = static_cast<uint16>((data[2] << 8) | data[3]);
+	if (opcode != CMSG_TIME_QUERY || bodySize != size - NTSPacket::HEADER_BYTE_SIZE
+		|| !m_query.ParseFromArray(data + NTSPacket::HEADER_BYTE_SIZE, bodySize))
+	{
+		++m_malformedCount;
+		return false;
+	}
+
+	if (this->isRateLimited(address, now))
+	{
+		++m_rateLimitedCount;
+		return false;
+	}
+
+	originateTimestamp = m_query.transmit_timestamp();
+
+	return true;
+}
+
+std::size_t NTSUdpServer::writeResult(uint8* buffer, int64 originateTimestamp, int64 receiveTimestamp, int64 transmitTimestamp)
+{
+	// The time (t1) when the client sends the request
+	m_result.set_originate_timestamp(originateTimestamp);
+	// The time (t2) when the server receives the request
+	m_result.set_receive_timestamp(receiveTimestamp);
+	// The time (t3) when the server sends the response
+	m_result.set_transmit_timestamp(transmitTimestamp);
+
+	uint16 bodySize = static_cast<uint16>(m_result.ByteSizeLong());
+	buffer[0] = 0xFF & (bodySize >> 8);
+	buffer[1] = 0xFF & bodySize;
+	buffer[2] = 0xFF & (SMSG_TIME_RESULT >> 8);
+	buffer[3] = 0xFF & SMSG_TIME_RESULT;
+	m_result.SerializeWithCachedSizesToArray(buffer + NTSPacket::HEADER_BYTE_SIZE);
+
+	return NTSPacket::HEADER_BYTE_SIZE + bodySize;
+}
+
+bool NTSUdpServer::isRateLimited(std::string const& address, int64 now)
+{
+	if (m_rateLimit <= 0.0)
+		return false;
+
+	// Addresses whose bucket has refilled behave the same as unknown addresses, so they can be forgotten
+	if (now - m_lastPurgeTime >= PURGE_INTERVAL)
+	{
+		for (auto it = m_buckets.begin(); it != m_buckets.end();)
+		{
+			if ((*it).second.isFull(now))
+				it = m_buckets.erase(it);
+			else
+				++it;
+		}
+		m_lastPurgeTime = now;
+	}
+
+	auto it = m_buckets.find(address);
+	if (it == m_buckets.end())
+	{
+		// Fail open: discarding the queries of every new address would turn a flood of spoofed
+		// addresses into an outage for all clients
+		if (m_buckets.size() >= MAX_TRACKED_ADDRESSES)
+			return false;
+
+		it = m_buckets.emplace(address, TokenBucket(m_rateLimit, m_rateBurst, now)).first;
+	}
+
+	return !(*it).second.consume(now);
+}
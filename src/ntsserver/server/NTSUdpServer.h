@@ -0,0 +1,83 @@
+#ifndef __NTS_UDP_SERVER_H__
+#define __NTS_UDP_SERVER_H__
+
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/asio.hpp>
+
+#include "protocol/pb/TimeQuery.pb.h"
+#include "protocol/pb/TimeResult.pb.h"
+
+#include "utilities/TokenBucket.h"
+
+// Stateless time service over UDP. Each datagram is a complete packet with the same
+// header (body size + opcode) and TimeQuery/TimeResult bodies as the TCP protocol,
+// so a query costs one datagram in each direction and no connection state is kept.
+// The service runs on its own thread. On Linux, datagrams are received and sent in
+// batches (recvmmsg/sendmmsg) and the receive timestamp is taken by the kernel (SO_TIMESTAMPNS)
+class NTSUdpServer
+{
+public:
+	enum
+	{
+		// Number of datagrams received or sent with one system call
+		BATCH_SIZE = 64,
+		// Queries are a few bytes, larger datagrams are discarded
+		MAX_DATAGRAM_SIZE = 256,
+		// A TimeResult is three varint timestamps
+		MAX_RESPONSE_SIZE = 64,
+		// Rate limit state of idle addresses is purged at this interval (in microseconds)
+		PURGE_INTERVAL = 10 * 1000000,
+		// When this many addresses are tracked, queries from new addresses are answered without a limit
+		// until the next purge
+		MAX_TRACKED_ADDRESSES = 1000000
+	};
+
+	static NTSUdpServer* instance();
+
+	bool start(std::string const& bindIp, uint16 port);
+	void stop();
+
+private:
+	NTSUdpServer();
+	~NTSUdpServer();
+
+	void run();
+#ifdef __linux__
+	void runBatched();
+#endif
+
+	// Validate and rate limit a query. Returns false if the query should not be answered.
+	// The address is the raw bytes of the client IP address
+	bool handleQuery(uint8 const* data, std::size_t size, std::string const& address, int64 now, int64& originateTimestamp);
+	// Write the response datagram and return its size. The transmit timestamp is taken
+	// by the caller after the whole batch has been processed, just before sending
+	std::size_t writeResult(uint8* buffer, int64 originateTimestamp, int64 receiveTimestamp, int64 transmitTimestamp);
+
+	bool isRateLimited(std::string const& address, int64 now);
+
+	boost::asio::io_service m_ioService;
+	boost::asio::ip::udp::socket m_socket;
+	boost::asio::ip::udp::endpoint m_localEndpoint;
+	std::thread* m_thread;
+	std::atomic<bool> m_stopped;
+
+	double m_rateLimit;
+	double m_rateBurst;
+	std::unordered_map<std::string, TokenBucket> m_buckets;
+	int64 m_lastPurgeTime;
+
+	TimeQuery m_query;
+	TimeResult m_result;
+
+	uint64 m_receivedCount;
+	uint64 m_answeredCount;
+	uint64 m_rateLimitedCount;
+	uint64 m_malformedCount;
+};
+
+#define sNTSUdpServer NTSUdpServer::instance()
+
+#endif // __NTS_UDP_SERVER_H__
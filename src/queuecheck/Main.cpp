@@ -0,0 +1,282 @@
+// Stress check of MPSCQueue. Several producers add numbered elements while the consumers remove them
+// with next(), peek() and drain(). The check fails if an element of a producer is lost, duplicated or
+// overtakes an earlier element of the same producer, or if the sum of the removed elements is wrong.
+// With two consumers, the consumers take turns like the world thread and the theater worker on the receive
+// queue of a session, see WorldSession::update(). The throughput is reported so that changes to the queue can be compared.
+// After the checks, the throughput of MPSCQueue is compared with the mutex-based ConcurrentQueue at 1, 4 and 16 producers
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "Common.h"
+#include "containers/ConcurrentQueue.h"
+#include "containers/MPSCQueue.h"
+#include "utilities/StringUtil.h"
+#include "utilities/TimeUtil.h"
+
+using namespace boost::program_options;
+
+namespace
+{
+	struct Item
+	{
+		Item() : producer(0), sequence(0) {}
+		Item(uint32 producer, uint64 sequence) : producer(producer), sequence(sequence) {}
+
+		uint32 producer;
+		uint64 sequence;
+	};
+
+	// Checks the elements in the order in which they were removed from the queue
+	class ItemChecker
+	{
+	public:
+		explicit ItemChecker(uint32 producerCount) :
+			m_nextSequences(producerCount, 0),
+			m_count(0),
+			m_sum(0),
+			m_errors(0)
+		{
+		}
+
+		void check(Item const& item)
+		{
+			++m_count;
+			m_sum += item.sequence;
+
+			if (item.producer >= m_nextSequences.size())
+				this->fail(StringUtil::format("Element of unknown producer %u", item.producer));
+			else if (item.sequence != m_nextSequences[item.producer])
+				this->fail(StringUtil::format("Producer %u: expected element %llu, removed element %llu", item.producer,
+					static_cast<unsigned long long>(m_nextSequences[item.producer]), static_cast<unsigned long long>(item.sequence)));
+			else
+				++m_nextSequences[item.producer];
+		}
+
+		void fail(std::string const& error)
+		{
+			// Only the first errors are printed, a broken queue usually fails on every element after them
+			if (m_errors++ < 10)
+				printf("  %s\n", error.c_str());
+		}
+
+		uint64 getCount() const { return m_count; }
+		uint64 getSum() const { return m_sum; }
+		uint64 getErrors() const { return m_errors; }
+
+	private:
+		std::vector<uint64> m_nextSequences;
+		uint64 m_count;
+		uint64 m_sum;
+		uint64 m_errors;
+	};
+
+	// Remove up to maxCount elements. Each round removes them in another way
+	uint64 consumeElements(MPSCQueue<Item>& queue, ItemChecker& checker, uint32 round, uint64 maxCount)
+	{
+		switch (round % 3)
+		{
+		case 0:
+			return queue.drain([&checker](Item& item) { checker.check(item); }, maxCount);
+		case 1:
+		{
+			uint64 count = 0;
+			Item item;
+			while (count < maxCount && queue.next(item))
+			{
+				checker.check(item);
+				++count;
+			}
+			return count;
+		}
+		default:
+		{
+			uint64 count = 0;
+			while (count < maxCount)
+			{
+				Item* peeked = queue.peek();
+				if (!peeked)
+					break;
+
+				Item expected = *peeked;
+				Item item;
+				if (!queue.next(item) || item.producer != expected.producer || item.sequence != expected.sequence)
+					checker.fail("next() did not remove the element returned by peek()");
+				checker.check(item);
+				++count;
+			}
+			return count;
+		}
+		}
+	}
+
+	bool runCheck(uint32 producerCount, uint32 consumerCount, uint64 elementCount, uint64 phaseSize)
+	{
+		MPSCQueue<Item> queue;
+		ItemChecker checker(producerCount);
+		uint64 total = producerCount * elementCount;
+
+		// The consumers are serialized by the turn, a consumer only touches the queue and the checker in its turn
+		std::atomic<uint32> turn(0);
+		std::atomic<bool> isDone(total == 0);
+		uint64 consumed = 0;
+		uint32 round = 0;
+
+		int64 startTime = getSteadyTimeMicros();
+
+		std::vector<std::thread> threads;
+		for (uint32 i = 0; i < producerCount; ++i)
+		{
+			threads.emplace_back([&queue, i, elementCount]() {
+				for (uint64 sequence = 0; sequence < elementCount; ++sequence)
+					queue.add(Item(i, sequence));
+			});
+		}
+
+		for (uint32 i = 0; i < consumerCount; ++i)
+		{
+			threads.emplace_back([&, i]() {
+				while (true)
+				{
+					while (!isDone.load(std::memory_order_acquire) && turn.load(std::memory_order_acquire) != i)
+						std::this_thread::yield();
+
+					if (isDone.load(std::memory_order_acquire))
+						break;
+
+					consumed += consumeElements(queue, checker, round++, phaseSize);
+					if (consumed >= total)
+						isDone.store(true, std::memory_order_release);
+
+					turn.store((i + 1) % consumerCount, std::memory_order_release);
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		double seconds = (getSteadyTimeMicros() - startTime) / 1000000.0;
+
+		if (!queue.empty())
+			checker.fail("The queue is not empty after all elements were removed");
+
+		uint64 expectedSum = producerCount * (elementCount * (elementCount - 1) / 2);
+		if (checker.getCount() != total || checker.getSum() != expectedSum)
+			checker.fail(StringUtil::format("Removed %llu elements with sum %llu, expected %llu elements with sum %llu",
+				static_cast<unsigned long long>(checker.getCount()), static_cast<unsigned long long>(checker.getSum()),
+				static_cast<unsigned long long>(total), static_cast<unsigned long long>(expectedSum)));
+
+		printf("%u producer(s), %u consumer(s): %llu elements in %.3f s (%.2f M/s) %s\n", producerCount, consumerCount,
+			static_cast<unsigned long long>(total), seconds, seconds > 0 ? total / seconds / 1000000.0 : 0.0,
+			checker.getErrors() == 0 ? "OK" : "FAILED");
+		fflush(stdout);
+
+		return checker.getErrors() == 0;
+	}
+
+	// Moves elementCount elements split across the producers through the queue to one consumer
+	// that removes them with next(), and returns the elements per second
+	template<class QUEUE>
+	double measureThroughput(uint32 producerCount, uint64 elementCount)
+	{
+		QUEUE queue;
+		uint64 perProducer = elementCount / producerCount;
+		uint64 total = perProducer * producerCount;
+
+		int64 startTime = getSteadyTimeMicros();
+
+		std::vector<std::thread> threads;
+		for (uint32 i = 0; i < producerCount; ++i)
+		{
+			threads.emplace_back([&queue, i, perProducer]() {
+				for (uint64 sequence = 0; sequence < perProducer; ++sequence)
+					queue.add(Item(i, sequence));
+			});
+		}
+
+		uint64 consumed = 0;
+		Item item;
+		while (consumed < total)
+		{
+			if (queue.next(item))
+				++consumed;
+			else
+				std::this_thread::yield();
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		double seconds = (getSteadyTimeMicros() - startTime) / 1000000.0;
+		return seconds > 0 ? total / seconds : 0.0;
+	}
+
+	void compareThroughput(uint64 elementCount)
+	{
+		static uint32 const producerCounts[] = { 1, 4, 16 };
+		for (uint32 producerCount : producerCounts)
+		{
+			double mpsc = measureThroughput<MPSCQueue<Item>>(producerCount, elementCount);
+			double concurrent = measureThroughput<ConcurrentQueue<Item>>(producerCount, elementCount);
+			printf("%2u producer(s), 1 consumer: MPSCQueue %.2f M/s, ConcurrentQueue %.2f M/s (%.2fx)\n", producerCount,
+				mpsc / 1000000.0, concurrent / 1000000.0, concurrent > 0 ? mpsc / concurrent : 0.0);
+			fflush(stdout);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32 producerCount;
+	uint64 elementCount;
+	uint64 phaseSize;
+	uint32 repeat;
+	uint64 benchElementCount;
+
+	try
+	{
+		options_description desc("Allowed options");
+		desc.add_options()
+			("help,h", "print usage message")
+			("producers,p", value<uint32>(&producerCount)->default_value(4), "number of producer threads")
+			("elements,n", value<uint64>(&elementCount)->default_value(1000000), "elements added by each producer")
+			("phase-size", value<uint64>(&phaseSize)->default_value(64), "elements removed by a consumer before the other consumer takes its turn")
+			("repeat,r", value<uint32>(&repeat)->default_value(1), "number of times each check is run")
+			("bench-elements", value<uint64>(&benchElementCount)->default_value(4000000), "elements moved by each throughput comparison, 0 skips the comparison");
+
+		variables_map vm;
+		store(command_line_parser(argc, argv).options(desc).run(), vm);
+		notify(vm);
+
+		if (vm.count("help"))
+		{
+			std::cout << desc << "\n";
+			return EXIT_SUCCESS;
+		}
+	}
+	catch (std::exception const& e)
+	{
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	producerCount = std::max<uint32>(producerCount, 1);
+	phaseSize = std::max<uint64>(phaseSize, 1);
+
+	bool isPassed = true;
+	for (uint32 i = 0; i < repeat; ++i)
+	{
+		isPassed = runCheck(producerCount, 1, elementCount, phaseSize) && isPassed;
+		isPassed = runCheck(producerCount, 2, elementCount, phaseSize) && isPassed;
+	}
+
+	if (benchElementCount > 0)
+		compareThroughput(benchElementCount);
+
+	return isPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
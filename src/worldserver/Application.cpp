@@ -3,9 +3,11 @@
 #include "debugging/Errors.h"
 #include "configuration/Config.h"
 #include "threading/ProcessPriority.h"
+#include "threading/ThreadAffinity.h"
 #include "logging/Log.h"
 #include "utilities/Util.h"
 #include "game/server/WorldSocketMgr.h"
+#include "game/server/SessionReplay.h"
 #include "game/world/World.h"
 
 #define DEFAULT_CONFIG_FILE     "worldserver.conf"
@@ -116,7 +118,13 @@ int Application::run(int argc, char** argv)
 	// Start the io_service thread pool
 	int numThreads = std::max(1, sConfigMgr->getIntDefault("ThreadPool", 1));
 	for (int i = 0; i < numThreads; ++i)
-		m_threadPool.emplace_back(boost::bind(&boost::asio::io_service::run, &m_ioService));
+	{
+		m_threadPool.emplace_back([this, i]()
+		{
+			pinCurrentThread("ThreadPool.Cores", i, "server.worldserver");
+			m_ioService.run();
+		});
+	}
 
 	// Create the PID file for worldserver
 	if (!pidFile.empty())
@@ -136,22 +144,42 @@ int Application::run(int argc, char** argv)
 		RETURN_FAILURE("Failed to initialize world.");
 	}
 
-	int networkThreads = sConfigMgr->getIntDefault("Network.Threads", 1);
-	if (networkThreads <= 0)
+	if (options.count("replay"))
 	{
-		RETURN_FAILURE("Network.Threads must be greater than 0");
-	}
+		// Replay the recorded sessions without listening for clients
+		std::string speedArg = options["replay-speed"].as<std::string>();
+		double speed = speedArg == "max" ? 0.0 : atof(speedArg.c_str());
+		if (speedArg != "max" && speed <= 0.0)
+		{
+			RETURN_FAILURE("Invalid replay speed %s", speedArg.c_str());
+		}
 
-	// Start listening socket for worldserver
-	if (!sWorldSocketMgr->startNetwork(m_ioService, worldListener, worldPort, networkThreads))
+		if (!sSessionReplayer->start(options["replay"].as<std::vector<std::string>>(), speed))
+		{
+			RETURN_FAILURE("Failed to start the replay.");
+		}
+	}
+	else
 	{
-		RETURN_FAILURE("Failed to start network.");
+		int networkThreads = sConfigMgr->getIntDefault("Network.Threads", 1);
+		if (networkThreads <= 0)
+		{
+			RETURN_FAILURE("Network.Threads must be greater than 0");
+		}
+
+		// Start listening socket for worldserver
+		if (!sWorldSocketMgr->startNetwork(m_ioService, worldListener, worldPort, networkThreads))
+		{
+			RETURN_FAILURE("Failed to start network.");
+		}
 	}
 
 	sWorld->run();
 
 	// Start shutting down the server
 
+	sSessionReplayer->stop();
+
 	shutdownThreadPool();
 
 	sLog->setSynchronous();
@@ -172,7 +200,9 @@ bool Application::parseCommandLine(int argc, char** argv, std::string& configFil
 	desc.add_options()
 		("help,h", "print usage message")
 		("version,v", "print version info")
-		("config,c", value<std::string>(&configFile), StringUtil::format("use <arg> as configuration file(e.g. \"%s\").", DEFAULT_CONFIG_FILE).c_str());
+		("config,c", value<std::string>(&configFile), StringUtil::format("use <arg> as configuration file(e.g. \"%s\").", DEFAULT_CONFIG_FILE).c_str())
+		("replay", value<std::vector<std::string>>()->multitoken(), "replay the session recordings (files or directories) of SessionRecorder instead of listening for clients")
+		("replay-speed", value<std::string>()->default_value("1x"), "replay speed, e.g. \"1x\", \"2x\" or \"max\" (as fast as the sessions accept the packets)");
 	variables_map vm;
 	store(command_line_parser(argc, argv).options(desc).run(), vm);
 	notify(vm);
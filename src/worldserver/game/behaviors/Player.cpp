@@ -1154,27 +1154,57 @@ void Player::sendInitSelf()
 		return;
 
 	UpdateObject update;
+	this->buildInitSelfUpdateBlocks(&update);
 
+	WorldPacket packet(SMSG_UPDATE_OBJECT);
+	this->getSession()->packAndSend(std::move(packet), update);
+
+	this->sendInitialVisiblePacketsToPlayer(this);
+}
+
+void Player::buildInitSelfUpdateBlocks(UpdateObject* update)
+{
 	for (int32 i = 0; i < UNIT_SLOTS_COUNT; ++i)
 	{
 		CarriedItem* item = m_carriedItems[i];
 		if (!item)
 			continue;
 
-		item->buildCreateUpdateBlockForPlayer(this, &update);
+		item->buildCreateUpdateBlockForPlayer(this, update);
 	}
-	this->buildCreateUpdateBlockForPlayer(this, &update);
-
-	WorldPacket packet(SMSG_UPDATE_OBJECT);
-	this->getSession()->packAndSend(std::move(packet), update);
-
-	this->sendInitialVisiblePacketsToPlayer(this);
+	this->buildCreateUpdateBlockForPlayer(this, update);
 }
 
 void Player::sendInitialPacketsAfterAddToMap()
 {
-	this->updateVisibilityForPlayer();
-	this->updateTraceabilityForPlayer();
+	WorldSession* session = this->getSession();
+	if (!session || !session->isRequiresCapability(REQUIRES_STREAMING))
+	{
+		this->sendInitSelf();
+		this->updateVisibilityForPlayer();
+		this->updateTraceabilityForPlayer();
+		return;
+	}
+
+	// The client accepts streamed packets, so the player, the visible objects and the tracked 
+	// objects are created with one update, however large it is
+	UpdateObject update;
+	this->buildInitSelfUpdateBlocks(&update);
+
+	VisibleNotifier visibleNotifier(*this);
+	this->visitNearbyObjects(this->getData()->getVisibleRange(), visibleNotifier);
+	update.append(visibleNotifier.getUpdateObject());
+
+	TrackingNotifier trackingNotifier(*this);
+	this->visitAllObjects(trackingNotifier);
+	update.append(trackingNotifier.getUpdateObject());
+
+	WorldPacket packet(SMSG_UPDATE_OBJECT);
+	session->packAndSend(std::move(packet), update);
+
+	this->sendInitialVisiblePacketsToPlayer(this);
+	for (WorldObject* object : visibleNotifier.getVisibleNow())
+		object->sendInitialVisiblePacketsToPlayer(this);
 }
 
 void Player::sendResetPackets()
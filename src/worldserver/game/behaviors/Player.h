@@ -36,6 +36,7 @@ public:
 	void removeFromWorld() override;
 
 	void sendInitSelf();
+	void buildInitSelfUpdateBlocks(UpdateObject* update);
 	void sendInitialPacketsAfterAddToMap();
 	void sendResetPackets();
 
@@ -58,6 +58,17 @@ void UpdateObject::addData(DataBasic* data, UpdateType updateType, uint32 update
 }
 
 
+void UpdateObject::append(UpdateObject& other)
+{
+	m_datas.reserve(m_datas.size() + other.m_datas.size());
+	for (auto& d : other.m_datas)
+		m_datas.emplace_back(std::move(d));
+	other.m_datas.clear();
+
+	m_outOfRangeGUIDs.insert(other.m_outOfRangeGUIDs.begin(), other.m_outOfRangeGUIDs.end());
+	other.m_outOfRangeGUIDs.clear();
+}
+
 size_t UpdateObject::sizeInBytes() const
 {
 	size_t totalSize = 0;
@@ -39,6 +39,9 @@ public:
 	void addOutOfRangeGUID(ObjectGuid const& guid) { m_outOfRangeGUIDs.insert(guid); }
 	void addOutOfRangeGUIDSet(GuidUnorderedSet& guids) { m_outOfRangeGUIDs.insert(guids.begin(), guids.end()); }
 
+	// Moves the updates of another object into this one, so they are sent with a single packet
+	void append(UpdateObject& other);
+
 	virtual size_t sizeInBytes() const override;
 
 	bool readFromStream(DataInputStream* input) override { return false; }
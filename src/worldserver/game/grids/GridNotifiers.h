@@ -34,6 +34,8 @@ public:
 
 	void sendToSelf();
 
+	UpdateObject& getUpdateObject() { return m_updateObject; }
+
 protected:
 	Player& m_player;
 	UpdateObject m_updateObject;
@@ -95,6 +97,10 @@ public:
 
 	void sendToSelf();
 
+	// The update and the objects that became visible, for sending them together with other updates instead of sendToSelf()
+	UpdateObject& getUpdateObject() { return m_updateObject; }
+	std::unordered_set<WorldObject*> const& getVisibleNow() const { return m_visibleNow; }
+
 protected:
 	Player& m_player;
 	UpdateObject m_updateObject;
@@ -204,6 +204,7 @@ void WorldSession::handleQueryCharacterInfo(WorldPacket& recvPacket)
 	recvPacket.unpack(query);
 
 	ObjectGuid guid(query.guid());
+	// The queried player may be in another theater, so the query is handled by the world thread (PROCESS_THREADUNSAFE)
 	Unit* unit = ObjectAccessor::getUnit(this->getPlayer(), guid);
 	// The character being queried may have already logged out of the game
 	if(unit)
@@ -3,7 +3,11 @@
 #include "game/server/protocol/pb/FlashMessage.pb.h"
 
 #include "configuration/Config.h"
+#include "networking/NetworkStats.h"
+#include "game/server/PacketLatencyStats.h"
+#include "networking/BufferPool.h"
 #include "game/world/World.h"
+#include "game/theater/TheaterManager.h"
 #include "game/world/ObjectAccessor.h"
 #include "game/world/ObjectMgr.h"
 #include "game/behaviors/UnitLocator.h"
@@ -36,6 +40,14 @@ boost::container::map<std::string, GMCommandHolder> gReloadCommandTable = {
     { "config",                  { &GMCommandWorker::executeReloadConfigCommand                         } },
 };
 
+boost::container::map<std::string, GMCommandHolder> gStatsCommandTable = {
+	{ "net",						{ &GMCommandWorker::executeStatsNetCommand							} },
+	{ "pool",						{ &GMCommandWorker::executeStatsPoolCommand							} },
+	{ "latency",					{ &GMCommandWorker::executeStatsLatencyCommand						} },
+	{ "world",						{ &GMCommandWorker::executeStatsWorldCommand						} },
+	{ "theater",					{ &GMCommandWorker::executeStatsTheaterCommand						} },
+};
+
 boost::container::map<std::string, GMCommandHolder> gCommandRootTable = {
 	{ "gm",					{ &GMCommandWorker::executeGMCommand										} },
 	{ "movespeed",			{ &GMCommandWorker::executeMoveSpeedCommand									} }, 
@@ -57,6 +69,7 @@ boost::container::map<std::string, GMCommandHolder> gCommandRootTable = {
 	{ "money",				{ &GMCommandWorker::executeMoneyCommand,									} },
 	{ "proficiency",		{ &GMCommandWorker::executeProficiencyCommand,								} },
 	{ "tileflag",			{ &GMCommandWorker::executeTileFlagCommand,									} },
+	{ "stats",				{ nullptr,											gStatsCommandTable		} },
 };
 
 GMCommandWorker::GMCommandWorker(WorldSession* session): 
@@ -1094,3 +1107,133 @@ bool GMCommandWorker::executeTileFlagCommand(ArgList& args, std::string& error)
 	}
 	return false;
 }
+
+bool GMCommandWorker::executeStatsNetCommand(ArgList& args, std::string& error)
+{
+	std::string desc = sNetworkStats->description();
+	NS_LOG_INFO("commands.gm", "Network stats: %s", desc.c_str());
+
+	FlashMessage flashMsg;
+	flashMsg.set_severity(FlashMessage::INFO);
+	flashMsg.set_message(desc);
+	m_session->sendFlashMessage(flashMsg);
+
+	if (this->takeOutArg(args) == "reset")
+		sNetworkStats->reset();
+
+	return true;
+}
+
+bool GMCommandWorker::executeStatsPoolCommand(ArgList& args, std::string& error)
+{
+	std::string desc = sBufferPool->description();
+	NS_LOG_INFO("commands.gm", "Buffer pool stats: %s", desc.c_str());
+
+	FlashMessage flashMsg;
+	flashMsg.set_severity(FlashMessage::INFO);
+	flashMsg.set_message(desc);
+	m_session->sendFlashMessage(flashMsg);
+
+	return true;
+}
+
+bool GMCommandWorker::executeStatsLatencyCommand(ArgList& args, std::string& error)
+{
+	std::string arg = this->takeOutArg(args);
+	std::string desc = sPacketLatencyStats->description(arg == "reset" ? "" : arg);
+	NS_LOG_INFO("commands.gm", "Packet latency stats:\n%s", desc.c_str());
+
+	FlashMessage flashMsg;
+	flashMsg.set_severity(FlashMessage::INFO);
+	flashMsg.set_message(desc);
+	m_session->sendFlashMessage(flashMsg);
+
+	if (arg == "reset")
+		sPacketLatencyStats->reset();
+
+	return true;
+}
+
+bool GMCommandWorker::executeStatsWorldCommand(ArgList& args, std::string& error)
+{
+	std::string arg = this->takeOutArg(args);
+
+	Histogram const& tickDuration = sWorld->getTickDuration();
+	Histogram const& tickLateness = sWorld->getTickLateness();
+	Histogram const& sessionUpdateTime = sTheaterManager->getSessionUpdateTime();
+	std::string desc = StringUtil::format("Tick: n: %llu, p50: %lluus, p99: %lluus, max: %lluus, overruns: %llu, skipped steps: %llu\n"
+		"Lateness: p50: %lluus, p99: %lluus, max: %lluus\n"
+		"Session update: p50: %lluus, p99: %lluus, max: %lluus, sessions on the world thread: %d/%d",
+		static_cast<unsigned long long>(tickDuration.getCount()),
+		static_cast<unsigned long long>(tickDuration.getPercentile(50)),
+		static_cast<unsigned long long>(tickDuration.getPercentile(99)),
+		static_cast<unsigned long long>(tickDuration.getMax()),
+		static_cast<unsigned long long>(sWorld->getOverrunCount()),
+		static_cast<unsigned long long>(sWorld->getSkippedStepCount()),
+		static_cast<unsigned long long>(tickLateness.getPercentile(50)),
+		static_cast<unsigned long long>(tickLateness.getPercentile(99)),
+		static_cast<unsigned long long>(tickLateness.getMax()),
+		static_cast<unsigned long long>(sessionUpdateTime.getPercentile(50)),
+		static_cast<unsigned long long>(sessionUpdateTime.getPercentile(99)),
+		static_cast<unsigned long long>(sessionUpdateTime.getMax()),
+		sTheaterManager->getSerialSessionCount(), sTheaterManager->getOnlineCount());
+	NS_LOG_INFO("commands.gm", "World stats:\n%s", desc.c_str());
+
+	FlashMessage flashMsg;
+	flashMsg.set_severity(FlashMessage::INFO);
+	flashMsg.set_message(desc);
+	m_session->sendFlashMessage(flashMsg);
+
+	if (arg == "reset")
+	{
+		sWorld->resetTickStats();
+		sTheaterManager->resetSessionUpdateTime();
+	}
+
+	return true;
+}
+
+bool GMCommandWorker::executeStatsTheaterCommand(ArgList& args, std::string& error)
+{
+	Theater const* theater = m_session->getTheater();
+	std::string arg = this->takeOutArg(args);
+	if (!arg.empty() && arg != "reset")
+	{
+		try
+		{
+			theater = sTheaterManager->findTheater(static_cast<uint32>(std::stoul(arg)));
+		}
+		catch (std::exception& e)
+		{
+			error = e.what();
+			return false;
+		}
+		arg = this->takeOutArg(args);
+	}
+
+	if (!theater || !theater->getMap())
+	{
+		error = "Theater not found.";
+		return false;
+	}
+
+	MapUpdateProfile& profile = theater->getMap()->getUpdateProfile();
+	std::string desc = StringUtil::format("Theater(ID: %u), players: %d, last update: %lldus, expected: %lldus, ticks over budget: %u\nLast tick: %s\n%s",
+		theater->getTheaterId(), theater->getOnlineCount(),
+		static_cast<long long>(theater->getLastUpdateTime()),
+		static_cast<long long>(theater->getExpectedUpdateTime()),
+		theater->getOverBudgetTicks(),
+		profile.describeLastTick().c_str(),
+		profile.description().c_str());
+	NS_LOG_INFO("commands.gm", "Theater stats:\n%s", desc.c_str());
+
+	FlashMessage flashMsg;
+	flashMsg.set_severity(FlashMessage::INFO);
+	flashMsg.set_message(desc);
+	m_session->sendFlashMessage(flashMsg);
+
+	if (arg == "reset")
+		profile.reset();
+
+	return true;
+}
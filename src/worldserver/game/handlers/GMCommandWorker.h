@@ -201,6 +201,48 @@ public:
 	//
 	bool executeTileFlagCommand(ArgList& args, std::string& error);
 
+	//
+	// Show network write statistics.
+	// Syntax: stats net [reset]
+	// Options:  
+	//		reset: Clear the counters after showing them.
+	//
+	bool executeStatsNetCommand(ArgList& args, std::string& error);
+
+	//
+	// Show packet buffer pool statistics.
+	// Syntax: stats pool
+	//
+	bool executeStatsPoolCommand(ArgList& args, std::string& error);
+
+	//
+	// Show per-opcode packet latency statistics: the queue wait and handler time of received packets,
+	// and the time from packing to the completed write of sent packets.
+	// Syntax: stats latency [reset|<opcode>]
+	// Options:  
+	//		reset: Clear the histograms after showing them.
+	//		opcode: Only show the opcodes whose names contain it, e.g. MOVE.
+	//
+	bool executeStatsLatencyCommand(ArgList& args, std::string& error);
+
+	//
+	// Show world tick statistics: the tick duration, overruns and skipped fixed steps, how late the ticks
+	// started, and the time the world thread spends updating the sessions.
+	// Syntax: stats world [reset]
+	// Options:  
+	//		reset: Clear the statistics after showing them.
+	//
+	bool executeStatsWorldCommand(ArgList& args, std::string& error);
+
+	//
+	// Show the update time of a theater and the time its phases took in the recent ticks.
+	// Syntax: stats theater [<id>] [reset]
+	// Options:  
+	//		id: The ID of the theater, the theater of the sender by default.
+	//		reset: Clear the phase histograms after showing them.
+	//
+	bool executeStatsTheaterCommand(ArgList& args, std::string& error);
+
 private:
 	ExecutionResult executeCommandInTable(ArgList& args, boost::container::map<std::string, GMCommandHolder> const& table, std::string& error);
 	Unit* getExecutionTarget(Player* sender, ArgList& args, std::string& error);
@@ -76,6 +76,12 @@ void WorldSession::handleMovementInfo(WorldPacket& recvPacket)
 
 	uint16 opcode = recvPacket.getOpcode();
 	DataPlayer* dPlayer = mover->getData();
+
+	// A heartbeat received over UDP may overtake a movement packet sent over TCP after it, 
+	// in which case the heartbeat is superseded by that packet
+	if (recvPacket.isDatagram() && m_hasStreamMovement 
+		&& static_cast<int32>(static_cast<uint32>(movement.time) - static_cast<uint32>(m_lastStreamMovementTime)) < 0)
+		return;
     
 	if (dPlayer->getMovementCounter() != movement.counter)
 	{
@@ -83,14 +89,39 @@ void WorldSession::handleMovementInfo(WorldPacket& recvPacket)
 		return;
 	}
 
+	// The heartbeats of lost datagrams are never received, so a heartbeat received over UDP may cover several 
+	// heartbeat intervals. The step limit is scaled by the sequence gap since the last heartbeat received over UDP, 
+	// bounded by the time elapsed since the last accepted movement packet so skipping sequences gains nothing
+	float maxStepLength = MAX_STEP_LENGTH;
+	if (recvPacket.isDatagram() && m_hasDatagramMovement && m_lastMovementReceiveTime > 0)
+	{
+		uint32 sequenceGap = recvPacket.getDatagramSequence() - m_lastDatagramSequence;
+		float elapsedIntervals = (recvPacket.getTimestamp() - m_lastMovementReceiveTime) / (MOVING_HEARTBEAT_INTERVAL_MAX * 1000000.0f);
+		float scale = std::min(static_cast<float>(sequenceGap), elapsedIntervals + 0.5f);
+		if (scale > 1.0f)
+			maxStepLength = MOVING_HEARTBEAT_INTERVAL_MAX * scale * MAX_MOVE_SPEED + 1.0f;
+	}
+
 	float dist = dPlayer->getPosition().getDistance(movement.position);
-	if (dist > MAX_STEP_LENGTH)
+	if (dist > maxStepLength)
 	{
-		NS_LOG_WARN("world.handler.movement", "Player(%s) move step length is out of range.(%f > %f)", movement.guid.toString().c_str(), dist, MAX_STEP_LENGTH);
+		NS_LOG_WARN("world.handler.movement", "Player(%s) move step length is out of range.(%f > %f)", movement.guid.toString().c_str(), dist, maxStepLength);
 		this->kickPlayer();
 		return;
 	}
 
+	m_lastMovementReceiveTime = recvPacket.getTimestamp();
+	if (recvPacket.isDatagram())
+	{
+		m_hasDatagramMovement = true;
+		m_lastDatagramSequence = recvPacket.getDatagramSequence();
+	}
+	else
+	{
+		m_hasStreamMovement = true;
+		m_lastStreamMovementTime = movement.time;
+	}
+
 	MovementInfo prevMovementInfo = dPlayer->getMovementInfo();
 
 	dPlayer->setMovementFlags(movement.flags);
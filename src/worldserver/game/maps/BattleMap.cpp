@@ -1,6 +1,7 @@
 #include "BattleMap.h"
 
 #include "game/server/protocol/pb/BattleUpdate.pb.h"
+#include "networking/SharedPayload.h"
 
 #include "logging/Log.h"
 #include "game/dynamic/TypeContainerVisitor.h"
@@ -65,6 +66,9 @@ BattleMap::BattleMap(MapData* data, SpawnManager* spawnManager) :
 	m_spawnManager->setMap(this);
 	m_unitSpawnPointGenerator.initialize();
 
+	m_updateProfile.setEnabled(sWorld->getBoolConfig(CONFIG_MAP_UPDATE_PROFILING_ENABLE));
+	m_updateProfile.setWindow(sWorld->getIntConfig(CONFIG_MAP_UPDATE_PROFILING_WINDOW) * 1000);
+
 	int32 nTiles = (int32)(m_mapData->getMapSize().width * m_mapData->getMapSize().height);
 	m_tileFlagsSet = new uint16[nTiles]();
 	this->initGrids();
@@ -132,6 +136,9 @@ void BattleMap::update(NSTime diff)
 	if (this->isStopped() || this->isBattleEnded())
 		return;
 
+	MapUpdatePhaseTimer phaseTimer(&m_updateProfile);
+	phaseTimer.start(MAP_UPDATE_PHASE_PLAYERS);
+
 	this->updatePatrolPoints();
 	this->resetAllMarkedGrids();
 
@@ -152,18 +159,25 @@ void BattleMap::update(NSTime diff)
 	}
 
 	// Update active objects other than players
+	phaseTimer.start(MAP_UPDATE_PHASE_OBJECTS);
 	ObjectUpdateNotifier updateNotifier(*this, diff);
 	this->visitCreatedGrids(updateNotifier);
 
+	phaseTimer.start(MAP_UPDATE_PHASE_NEW_GRIDS);
 	this->processObjectToNewGridList();
+	phaseTimer.start(MAP_UPDATE_PHASE_RELOCATION);
 	this->processRelocationNotifies(diff);
+	phaseTimer.start(MAP_UPDATE_PHASE_REMOVAL);
 	this->processObjectRemoveList();
 
 	// Update object spawning manager
+	phaseTimer.start(MAP_UPDATE_PHASE_SPAWNING);
 	m_spawnManager->update(diff);
 
+	phaseTimer.start(MAP_UPDATE_PHASE_OBJECT_UPDATES);
 	this->sendObjectUpdates();
 
+	phaseTimer.start(MAP_UPDATE_PHASE_BATTLE_STATE);
 	this->updateBattleState(diff);
 }
 
@@ -192,8 +206,6 @@ void BattleMap::addPlayerToMap(Player* player)
 	player->setMap(this);
 	player->addToWorld();
 
-	player->sendInitSelf();
-
 	player->updateObjectVisibility();
 	player->updateObjectTraceability();
 	player->updateObjectSafety();
@@ -289,6 +301,53 @@ void BattleMap::sendBattleUpdate(Player* player, uint32 updateFlags)
 		return;
 
 	BattleUpdate update;
+	this->buildBattleUpdate(update, player->getSession(), updateFlags);
+
+	WorldPacket packet(SMSG_BATTLE_UPDATE);
+	player->getSession()->packAndSend(std::move(packet), update);
+}
+
+void BattleMap::sendBattleUpdateToPlayers(uint32 updateFlags)
+{
+	if (this->isBattleUpdatePerPlayer(updateFlags))
+	{
+		for (auto it = m_playerList.begin(); it != m_playerList.end(); ++it)
+		{
+			Player* player = (*it).second;
+			this->sendBattleUpdate(player, updateFlags);
+		}
+		return;
+	}
+
+	// The update is the same for all players, it is serialized once and shared by their packets
+	SharedPayloadPtr payload;
+	for (auto it = m_playerList.begin(); it != m_playerList.end(); ++it)
+	{
+		Player* player = (*it).second;
+		if (!player->getSession())
+			continue;
+
+		if (!payload)
+		{
+			BattleUpdate update;
+			this->buildBattleUpdate(update, nullptr, updateFlags);
+			payload = SharedPayload::create(update);
+		}
+		player->getSession()->sendSharedPacket(SMSG_BATTLE_UPDATE, payload);
+	}
+}
+
+bool BattleMap::isBattleUpdatePerPlayer(uint32 updateFlags) const
+{
+	// The start time is converted to the client time of each player
+	if ((updateFlags & BATTLE_UPDATEFLAG_STATE) == 0)
+		return false;
+
+	return m_battleState == BATTLE_STATE_PREPARING || m_battleState == BATTLE_STATE_IN_PROGRESS;
+}
+
+void BattleMap::buildBattleUpdate(BattleUpdate& update, WorldSession* session, uint32 updateFlags) const
+{
 	update.set_update_flags(updateFlags);
 
 	if ((updateFlags & BATTLE_UPDATEFLAG_STATE) != 0)
@@ -299,14 +358,14 @@ void BattleMap::sendBattleUpdate(Player* player, uint32 updateFlags)
 		{
 			update.set_preparation_duration(m_battleStateTimer.getDuration());
 			update.set_battle_duration(this->getDurationByBattleState(BATTLE_STATE_IN_PROGRESS));
-			NSTime startTime = player->getSession()->getClientNowTimeMillis() - this->getBattleStateElapsedTime();
+			NSTime startTime = session->getClientNowTimeMillis() - this->getBattleStateElapsedTime();
 			update.set_start_time(startTime);
 			break;
 		}
 		case BATTLE_STATE_IN_PROGRESS:
 		{
 			update.set_battle_duration(m_battleStateTimer.getDuration());
-			NSTime startTime = player->getSession()->getClientNowTimeMillis() - this->getBattleStateElapsedTime();
+			NSTime startTime = session->getClientNowTimeMillis() - this->getBattleStateElapsedTime();
 			update.set_start_time(startTime);
 			break;
 		}
@@ -321,18 +380,6 @@ void BattleMap::sendBattleUpdate(Player* player, uint32 updateFlags)
 
 	if ((updateFlags & BATTLE_UPDATEFLAG_MAGICBEAN_COUNT) != 0)
 		update.set_magicbean_count(m_spawnManager->getClassifiedItemCount(ITEM_CLASS_MAGIC_BEAN));
-
-	WorldPacket packet(SMSG_BATTLE_UPDATE);
-	player->getSession()->packAndSend(std::move(packet), update);
-}
-
-void BattleMap::sendBattleUpdateToPlayers(uint32 updateFlags)
-{
-	for (auto it = m_playerList.begin(); it != m_playerList.end(); ++it)
-	{
-		Player* player = (*it).second;
-		this->sendBattleUpdate(player, updateFlags);
-	}
 }
 
 bool BattleMap::isWithinCombatGrade(uint16 combatPower) const
@@ -702,25 +749,28 @@ void BattleMap::sendObjectUpdates()
 
 void BattleMap::sendGlobalFlashMessage(FlashMessage const& message, Player* self)
 {
-	for (auto iter = m_playerList.begin(); iter != m_playerList.end(); ++iter)
-	{
-		Player* player = (*iter).second;
-		if (player == self || !player->getSession())
-			continue;
-
-		player->getSession()->sendFlashMessage(message);
-	}
+	this->sendGlobalMessage(SMSG_FLASH_MESSAGE, message, self);
 }
 
 void BattleMap::sendGlobalPlayerActionMessage(PlayerActionMessage const& message, Player* self)
 {
+	this->sendGlobalMessage(SMSG_PLAYER_ACTION_MESSAGE, message, self);
+}
+
+void BattleMap::sendGlobalMessage(uint16 opcode, MessageLite const& message, Player* self)
+{
+	// The message is serialized once when the first recipient is found, 
+	// and all recipients share the serialized body
+	SharedPayloadPtr payload;
 	for (auto iter = m_playerList.begin(); iter != m_playerList.end(); ++iter)
 	{
 		Player* player = (*iter).second;
 		if (player == self || !player->getSession())
 			continue;
 
-		player->getSession()->sendPlayerActionMessage(message);
+		if (!payload)
+			payload = SharedPayload::create(message);
+		player->getSession()->sendSharedPacket(opcode, payload);
 	}
 }
 
@@ -5,6 +5,7 @@
 
 #include "game/server/protocol/pb/FlashMessage.pb.h"
 #include "game/server/protocol/pb/PlayerActionMessage.pb.h"
+#include "game/server/protocol/pb/BattleUpdate.pb.h"
 
 #include "utilities/Timer.h"
 #include "game/grids/GridDefines.h"
@@ -19,6 +20,7 @@
 #include "SpawnManager.h"
 #include "WaypointNode.h"
 #include "UnitSpawnPointGenerator.h"
+#include "MapUpdateProfile.h"
 
 enum BattleUpdateFlag
 {
@@ -51,6 +53,7 @@ class WorldObject;
 class Robot;
 class Player;
 class ObjectUpdater;
+class WorldSession;
 
 class BattleMap
 {
@@ -135,6 +138,7 @@ public:
 	std::unordered_map<ObjectGuid, Player*>& getPlayerList() { return m_playerList; }
 	MapStoredObjectMapContainer& getObjectsStore() { return m_objectsStore; }
 	SpawnManager* getSpawnManager() { return m_spawnManager; }
+	MapUpdateProfile& getUpdateProfile() { return m_updateProfile; }
 
 	void addObjectToRemoveList(WorldObject* obj);
 	template<typename T> T* takeReusableObject();
@@ -206,6 +210,11 @@ private:
 	void setSafeZoneCenter(TileCoord const& center);
 
 	void updateBattleState(NSTime diff);
+	// The session is used to convert the start time to the client time, 
+	// it may be null if the update does not contain the start time
+	void buildBattleUpdate(BattleUpdate& update, WorldSession* session, uint32 updateFlags) const;
+	bool isBattleUpdatePerPlayer(uint32 updateFlags) const;
+	void sendGlobalMessage(uint16 opcode, google::protobuf::MessageLite const& message, Player* self);
 	Player* findVictoriousPlayer() const;
 
 	bool isGridMarked(GridCoord const& coord) const { return m_markedGrids.test(coord.y * MAX_NUMBER_OF_GRIDS + coord.x); }
@@ -309,6 +318,8 @@ private:
 	bool m_isPatrolPointsDirty;
 	RadialPointIndexMap m_patrolPointIndexes;
 	RadialPointList m_patrolPointList;
+
+	MapUpdateProfile m_updateProfile;
 };
 
 template<typename VISITOR>
@@ -0,0 +1,128 @@
+#include "MapUpdateProfile.h"
+
+#include "utilities/StringUtil.h"
+#include "utilities/TimeUtil.h"
+
+MapUpdateProfile::MapUpdateProfile() :
+	m_isEnabled(true),
+	m_window(60000),
+	m_windowStartTime(0),
+	m_currentWindow(0)
+{
+	for (int32 phase = 0; phase < MAX_MAP_UPDATE_PHASES; ++phase)
+		m_lastTimes[phase] = 0;
+}
+
+void MapUpdateProfile::beginTick()
+{
+	for (int32 phase = 0; phase < MAX_MAP_UPDATE_PHASES; ++phase)
+		m_lastTimes[phase] = 0;
+
+	if (!m_isEnabled)
+		return;
+
+	// The oldest window is cleared and becomes the current one
+	int64 now = getUptimeMillis();
+	if (now - m_windowStartTime >= m_window)
+	{
+		m_currentWindow = 1 - m_currentWindow;
+		for (int32 phase = 0; phase < MAX_MAP_UPDATE_PHASES; ++phase)
+			m_histograms[m_currentWindow][phase].reset();
+		m_windowStartTime = now;
+	}
+}
+
+void MapUpdateProfile::add(MapUpdatePhase phase, int64 micros)
+{
+	m_lastTimes[phase] += micros;
+	m_histograms[m_currentWindow][phase].add(micros);
+}
+
+int64 MapUpdateProfile::getLastTickTime() const
+{
+	int64 time = 0;
+	for (int32 phase = 0; phase < MAX_MAP_UPDATE_PHASES; ++phase)
+		time += m_lastTimes[phase];
+
+	return time;
+}
+
+std::string MapUpdateProfile::describeLastTick() const
+{
+	std::string desc;
+	for (int32 phase = 0; phase < MAX_MAP_UPDATE_PHASES; ++phase)
+	{
+		if (!desc.empty())
+			desc += ", ";
+		desc += StringUtil::format("%s: %lldus", getPhaseName(static_cast<MapUpdatePhase>(phase)), static_cast<long long>(m_lastTimes[phase]));
+	}
+
+	return desc;
+}
+
+std::string MapUpdateProfile::description() const
+{
+	std::string desc;
+	for (int32 phase = 0; phase < MAX_MAP_UPDATE_PHASES; ++phase)
+	{
+		Histogram histogram;
+		histogram.merge(m_histograms[0][phase]);
+		histogram.merge(m_histograms[1][phase]);
+		if (histogram.getCount() == 0)
+			continue;
+
+		if (!desc.empty())
+			desc += '\n';
+		desc += StringUtil::format("%s, n: %llu, mean: %.0fus, p50: %lluus, p99: %lluus, max: %lluus",
+			getPhaseName(static_cast<MapUpdatePhase>(phase)),
+			static_cast<unsigned long long>(histogram.getCount()),
+			histogram.getMean(),
+			static_cast<unsigned long long>(histogram.getPercentile(50)),
+			static_cast<unsigned long long>(histogram.getPercentile(99)),
+			static_cast<unsigned long long>(histogram.getMax()));
+	}
+
+	return desc.empty() ? "no samples" : desc;
+}
+
+void MapUpdateProfile::reset()
+{
+	for (int32 window = 0; window < 2; ++window)
+	{
+		for (int32 phase = 0; phase < MAX_MAP_UPDATE_PHASES; ++phase)
+			m_histograms[window][phase].reset();
+	}
+	m_windowStartTime = getUptimeMillis();
+}
+
+char const* MapUpdateProfile::getPhaseName(MapUpdatePhase phase)
+{
+	static char const* phaseNames[MAX_MAP_UPDATE_PHASES] = {
+		"packets", "players", "objects", "new grids", "relocation", "removal", "spawning", "object updates", "battle state"
+	};
+
+	return phaseNames[phase];
+}
+
+
+void MapUpdatePhaseTimer::start(MapUpdatePhase phase)
+{
+	if (!m_profile)
+		return;
+
+	int64 now = getSteadyTimeMicros();
+	if (m_phase != MAX_MAP_UPDATE_PHASES)
+		m_profile->add(m_phase, now - m_startTime);
+
+	m_phase = phase;
+	m_startTime = now;
+}
+
+void MapUpdatePhaseTimer::stop()
+{
+	if (!m_profile || m_phase == MAX_MAP_UPDATE_PHASES)
+		return;
+
+	m_profile->add(m_phase, getSteadyTimeMicros() - m_startTime);
+	m_phase = MAX_MAP_UPDATE_PHASES;
+}
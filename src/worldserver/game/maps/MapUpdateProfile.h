@@ -0,0 +1,87 @@
+#ifndef __MAP_UPDATE_PROFILE_H__
+#define __MAP_UPDATE_PROFILE_H__
+
+#include "Common.h"
+#include "utilities/Histogram.h"
+
+enum MapUpdatePhase
+{
+	// The packets handled by the update of the theater, see TheaterUpdateThreads.ProcessPackets
+	MAP_UPDATE_PHASE_PACKETS,
+	// The players and the passive objects in the grids around them
+	MAP_UPDATE_PHASE_PLAYERS,
+	// The active objects other than players
+	MAP_UPDATE_PHASE_OBJECTS,
+	MAP_UPDATE_PHASE_NEW_GRIDS,
+	MAP_UPDATE_PHASE_RELOCATION,
+	MAP_UPDATE_PHASE_REMOVAL,
+	MAP_UPDATE_PHASE_SPAWNING,
+	MAP_UPDATE_PHASE_OBJECT_UPDATES,
+	MAP_UPDATE_PHASE_BATTLE_STATE,
+	MAX_MAP_UPDATE_PHASES
+};
+
+// The time (in microseconds) the phases of the update of a map take, see MapUpdateProfiling.Enable.
+// The histograms cover the current and the previous window, so they reflect the recent updates.
+// The profile is written by the update of the theater and read between the updates
+class MapUpdateProfile
+{
+public:
+	MapUpdateProfile();
+
+	void setEnabled(bool enabled) { m_isEnabled = enabled; }
+	bool isEnabled() const { return m_isEnabled; }
+	// The length of a window, in milliseconds
+	void setWindow(int64 window) { m_window = window; }
+
+	// Called at the start of each update of the theater
+	void beginTick();
+	void add(MapUpdatePhase phase, int64 micros);
+
+	int64 getLastTime(MapUpdatePhase phase) const { return m_lastTimes[phase]; }
+	// The sum of the phase times of the last update
+	int64 getLastTickTime() const;
+	// The phase times of the last update on one line
+	std::string describeLastTick() const;
+	// One line per phase with samples
+	std::string description() const;
+	void reset();
+
+	static char const* getPhaseName(MapUpdatePhase phase);
+
+private:
+	bool m_isEnabled;
+	int64 m_window;
+	int64 m_windowStartTime;
+	int32 m_currentWindow;
+	Histogram m_histograms[2][MAX_MAP_UPDATE_PHASES];
+	int64 m_lastTimes[MAX_MAP_UPDATE_PHASES];
+};
+
+// Measures the phases of an update in sequence, each phase lasts until the next one starts
+// or the timer is destroyed. Does nothing if the profile is null or disabled
+class MapUpdatePhaseTimer
+{
+public:
+	explicit MapUpdatePhaseTimer(MapUpdateProfile* profile) :
+		m_profile(profile && profile->isEnabled() ? profile : nullptr),
+		m_phase(MAX_MAP_UPDATE_PHASES),
+		m_startTime(0)
+	{
+	}
+
+	~MapUpdatePhaseTimer()
+	{
+		this->stop();
+	}
+
+	void start(MapUpdatePhase phase);
+	void stop();
+
+private:
+	MapUpdateProfile* m_profile;
+	MapUpdatePhase m_phase;
+	int64 m_startTime;
+};
+
+#endif // __MAP_UPDATE_PROFILE_H__
@@ -0,0 +1,67 @@
+#include "PacketLatencyStats.h"
+
+#include "utilities/StringUtil.h"
+#include "protocol/OpcodeHandler.h"
+
+PacketLatencyStats::PacketLatencyStats() :
+	m_isEnabled(true)
+{
+}
+
+PacketLatencyStats::~PacketLatencyStats()
+{
+}
+
+PacketLatencyStats* PacketLatencyStats::instance()
+{
+	static PacketLatencyStats instance;
+	return &instance;
+}
+
+void PacketLatencyStats::reset()
+{
+	for (int32 stage = 0; stage < MAX_PACKET_LATENCY_STAGES; ++stage)
+	{
+		for (int32 opcode = 0; opcode < NUM_MSG_TYPES; ++opcode)
+			m_histograms[stage][opcode].reset();
+	}
+}
+
+std::string PacketLatencyStats::description(std::string const& filter) const
+{
+	static char const* stageNames[MAX_PACKET_LATENCY_STAGES] = { "wait", "handler", "send" };
+
+	std::string desc;
+	for (uint16 opcode = 0; opcode < NUM_MSG_TYPES; ++opcode)
+	{
+		char const* name = lookupOpcodeName(opcode);
+		if (!filter.empty() && std::string(name).find(filter) == std::string::npos)
+			continue;
+
+		std::string line;
+		for (int32 stage = 0; stage < MAX_PACKET_LATENCY_STAGES; ++stage)
+		{
+			if (m_histograms[stage][opcode].getCount() == 0)
+				continue;
+
+			Histogram histogram;
+			m_histograms[stage][opcode].collect(histogram);
+
+			line += StringUtil::format(", %s n: %llu, p50: %lluus, p99: %lluus, max: %lluus", stageNames[stage],
+				static_cast<unsigned long long>(histogram.getCount()),
+				static_cast<unsigned long long>(histogram.getPercentile(50)),
+				static_cast<unsigned long long>(histogram.getPercentile(99)),
+				static_cast<unsigned long long>(histogram.getMax()));
+		}
+
+		if (line.empty())
+			continue;
+
+		if (!desc.empty())
+			desc += '\n';
+		desc += name;
+		desc += line;
+	}
+
+	return desc.empty() ? "no samples" : desc;
+}
@@ -0,0 +1,53 @@
+#ifndef __PACKET_LATENCY_STATS_H__
+#define __PACKET_LATENCY_STATS_H__
+
+#include <atomic>
+
+#include "Common.h"
+#include "utilities/ShardedHistogram.h"
+#include "protocol/Opcode.h"
+
+enum PacketLatencyStage
+{
+	// Time from reading a received packet from the socket to the start of its handler
+	PACKET_LATENCY_QUEUE_WAIT,
+	// Time spent in the handler of a received packet
+	PACKET_LATENCY_HANDLER,
+	// Time from packing a packet to the completion of the socket write that sent it
+	PACKET_LATENCY_SEND,
+	MAX_PACKET_LATENCY_STAGES
+};
+
+// Per-opcode latency histograms (in microseconds) of the packets received and sent by the sessions,
+// see LatencyStats.Enable. Samples may be added from any thread
+class PacketLatencyStats
+{
+public:
+	static PacketLatencyStats* instance();
+
+	void setEnabled(bool enabled) { m_isEnabled = enabled; }
+	bool isEnabled() const { return m_isEnabled; }
+
+	void add(PacketLatencyStage stage, uint16 opcode, int64 micros)
+	{
+		if (opcode < NUM_MSG_TYPES)
+			m_histograms[stage][opcode].add(micros);
+	}
+
+	void getHistogram(PacketLatencyStage stage, uint16 opcode, Histogram& result) const { m_histograms[stage][opcode].collect(result); }
+
+	void reset();
+	// One line per opcode with samples. If a filter is specified, only the opcodes whose names contain it are described
+	std::string description(std::string const& filter = "") const;
+
+private:
+	PacketLatencyStats();
+	~PacketLatencyStats();
+
+	std::atomic<bool> m_isEnabled;
+	ShardedHistogram m_histograms[MAX_PACKET_LATENCY_STAGES][NUM_MSG_TYPES];
+};
+
+#define sPacketLatencyStats PacketLatencyStats::instance()
+
+#endif // __PACKET_LATENCY_STATS_H__
@@ -0,0 +1,198 @@
+#include "SessionRecorder.h"
+
+#include <boost/filesystem.hpp>
+
+#include "configuration/Config.h"
+#include "logging/Log.h"
+#include "utilities/StringUtil.h"
+#include "utilities/TimeUtil.h"
+#include "Application.h"
+
+namespace
+{
+	void writeUInt16(std::vector<uint8>& buffer, uint16 value)
+	{
+		buffer.push_back(uint8(0xFF & (value >> 8)));
+		buffer.push_back(uint8(0xFF & value));
+	}
+
+	void writeUInt32(std::vector<uint8>& buffer, uint32 value)
+	{
+		writeUInt16(buffer, uint16(value >> 16));
+		writeUInt16(buffer, uint16(value));
+	}
+
+	void writeInt64(std::vector<uint8>& buffer, int64 value)
+	{
+		writeUInt32(buffer, uint32(uint64(value) >> 32));
+		writeUInt32(buffer, uint32(value));
+	}
+
+	uint16 readUInt16(uint8 const* data)
+	{
+		return uint16((data[0] << 8) | data[1]);
+	}
+
+	uint32 readUInt32(uint8 const* data)
+	{
+		return (uint32(readUInt16(data)) << 16) | readUInt16(data + 2);
+	}
+
+	int64 readInt64(uint8 const* data)
+	{
+		return int64((uint64(readUInt32(data)) << 32) | readUInt32(data + 4));
+	}
+}
+
+SessionRecording::SessionRecording(FILE* file, std::string const& address, uint16 port) :
+	m_file(file),
+	m_lastRecordTime(getSteadyTimeMicros())
+{
+	std::vector<uint8> header(SESSION_RECORDING_MAGIC, SESSION_RECORDING_MAGIC + 4);
+	writeUInt16(header, SESSION_RECORDING_VERSION);
+	writeInt64(header, getSystemTimeMillis());
+	uint8 addressLength = uint8(std::min<size_t>(address.size(), 0xFF));
+	header.push_back(addressLength);
+	header.insert(header.end(), address.begin(), address.begin() + addressLength);
+	writeUInt16(header, port);
+
+	fwrite(header.data(), 1, header.size(), m_file);
+}
+
+SessionRecording::~SessionRecording()
+{
+	fclose(m_file);
+}
+
+void SessionRecording::record(WorldPacket const& packet)
+{
+	int64 now = getSteadyTimeMicros();
+	int64 delay = std::min<int64>(std::max<int64>(now - m_lastRecordTime, 0), 0xFFFFFFFF);
+	m_lastRecordTime = now;
+
+	std::vector<uint8> header;
+	header.reserve(10);
+	writeUInt32(header, uint32(delay));
+	writeUInt16(header, packet.getOpcode());
+	writeUInt32(header, packet.getBodyBytes());
+	fwrite(header.data(), 1, header.size(), m_file);
+
+	for (uint32 i = 0, frameCount = packet.getFrameCount(); i < frameCount; ++i)
+	{
+		if (packet.getFrameBodyBytes(i) > 0)
+			fwrite(packet.getFrameBodyData(i), 1, packet.getFrameBodyBytes(i), m_file);
+	}
+}
+
+
+SessionRecordingReader::SessionRecordingReader() :
+	m_file(nullptr),
+	m_startTime(0),
+	m_remotePort(0)
+{
+}
+
+SessionRecordingReader::~SessionRecordingReader()
+{
+	if (m_file)
+		fclose(m_file);
+}
+
+bool SessionRecordingReader::open(std::string const& fileName)
+{
+	m_fileName = fileName;
+	m_file = fopen(fileName.c_str(), "rb");
+	if (!m_file)
+		return false;
+
+	uint8 header[15];
+	if (fread(header, 1, sizeof(header), m_file) != sizeof(header)
+		|| memcmp(header, SESSION_RECORDING_MAGIC, 4) != 0
+		|| readUInt16(header + 4) != SESSION_RECORDING_VERSION)
+		return false;
+
+	m_startTime = readInt64(header + 6);
+
+	uint8 addressLength = header[14];
+	uint8 address[0xFF + 2];
+	if (fread(address, 1, addressLength + 2, m_file) != size_t(addressLength + 2))
+		return false;
+
+	m_remoteAddress.assign(address, address + addressLength);
+	m_remotePort = readUInt16(address + addressLength);
+
+	return true;
+}
+
+bool SessionRecordingReader::next(int64& delay, WorldPacket& packet)
+{
+	uint8 header[10];
+	if (!m_file || fread(header, 1, sizeof(header), m_file) != sizeof(header))
+		return false;
+
+	uint32 bodySize = readUInt32(header + 6);
+	if (bodySize > WorldPacket::MAX_STREAM_BYTE_SIZE)
+		return false;
+
+	m_body.resize(bodySize);
+	if (bodySize > 0 && fread(m_body.data(), 1, bodySize, m_file) != bodySize)
+		return false;
+
+	delay = readUInt32(header);
+	packet = WorldPacket(readUInt16(header + 4));
+	packet.setBody(m_body.data(), bodySize);
+
+	return true;
+}
+
+
+SessionRecorder::SessionRecorder() :
+	m_isEnabled(false),
+	m_sequence(0)
+{
+}
+
+SessionRecorder::~SessionRecorder()
+{
+}
+
+SessionRecorder* SessionRecorder::instance()
+{
+	static SessionRecorder instance;
+	return &instance;
+}
+
+void SessionRecorder::loadConfig()
+{
+	m_isEnabled = sConfigMgr->getBoolDefault("SessionRecorder.Enable", false);
+	m_dir = sApplication->getRoot() + sConfigMgr->getStringDefault("SessionRecorder.Dir", "recordings");
+	if (!m_isEnabled)
+		return;
+
+	boost::system::error_code error;
+	boost::filesystem::create_directories(m_dir, error);
+	if (error)
+	{
+		NS_LOG_ERROR("world.recorder", "Failed to create the recording directory %s, recording is disabled. error: %s", m_dir.c_str(), error.message().c_str());
+		m_isEnabled = false;
+		return;
+	}
+
+	NS_LOG_INFO("world.recorder", "Recording the inbound traffic of sessions to %s", m_dir.c_str());
+}
+
+std::unique_ptr<SessionRecording> SessionRecorder::createRecording(std::string const& address, uint16 port)
+{
+	if (!m_isEnabled)
+		return nullptr;
+
+	std::string fileName = StringUtil::format("%s/%lld-%u.rec", m_dir.c_str(), static_cast<long long>(getSystemTimeMillis()), uint32(++m_sequence));
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (!file)
+	{
+		NS_LOG_ERROR("world.recorder", "Failed to create the recording file %s", fileName.c_str());
+		return nullptr;
+	}
+
+	return std_extensions::make_unique<SessionRecording>(file, address, port);
+}
@@ -0,0 +1,83 @@
+#ifndef __SESSION_RECORDER_H__
+#define __SESSION_RECORDER_H__
+
+#include <atomic>
+
+#include "Common.h"
+#include "WorldSocket.h"
+
+// Layout of a recording file. All integers are big-endian
+//    Header: magic "NSRC", uint16 version, int64 start time (Unix time in milliseconds),
+//            uint8 address length, address, uint16 port
+//    Record: uint32 time since the previous record (in microseconds), uint16 opcode, uint32 body size, body
+#define SESSION_RECORDING_MAGIC			"NSRC"
+#define SESSION_RECORDING_VERSION		1
+
+// Writes the packets received on one client connection to a recording file.
+// It is used only by the network thread of the socket
+class SessionRecording
+{
+public:
+	SessionRecording(FILE* file, std::string const& address, uint16 port);
+	~SessionRecording();
+
+	void record(WorldPacket const& packet);
+
+private:
+	FILE* m_file;
+	int64 m_lastRecordTime;
+};
+
+// Reads the header and records of a recording file written by SessionRecording
+class SessionRecordingReader
+{
+public:
+	SessionRecordingReader();
+	~SessionRecordingReader();
+
+	SessionRecordingReader(SessionRecordingReader const& right) = delete;
+	SessionRecordingReader& operator=(SessionRecordingReader const& right) = delete;
+
+	bool open(std::string const& fileName);
+	// Read the next record. Returns false at the end of the file or if the record is truncated
+	bool next(int64& delay, WorldPacket& packet);
+
+	std::string const& getFileName() const { return m_fileName; }
+	int64 getStartTime() const { return m_startTime; }
+	std::string const& getRemoteAddress() const { return m_remoteAddress; }
+	uint16 getRemotePort() const { return m_remotePort; }
+
+private:
+	FILE* m_file;
+	std::string m_fileName;
+	int64 m_startTime;
+	std::string m_remoteAddress;
+	uint16 m_remotePort;
+	std::vector<uint8> m_body;
+};
+
+// Creates the recordings of inbound traffic of client connections, see SessionRecorder.Enable
+class SessionRecorder
+{
+public:
+	static SessionRecorder* instance();
+
+	void loadConfig();
+	bool isEnabled() const { return m_isEnabled; }
+
+	// Create the recording file of a new connection.
+	// Returns nullptr if recording is disabled or the file cannot be created
+	std::unique_ptr<SessionRecording> createRecording(std::string const& address, uint16 port);
+
+private:
+	SessionRecorder();
+	~SessionRecorder();
+
+	bool m_isEnabled;
+	std::string m_dir;
+	std::atomic<uint32> m_sequence;
+};
+
+#define sSessionRecorder SessionRecorder::instance()
+
+#endif // __SESSION_RECORDER_H__
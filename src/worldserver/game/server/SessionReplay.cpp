@@ -0,0 +1,345 @@
+#include "SessionReplay.h"
+
+#include "protocol/pb/AuthProof.pb.h"
+#include "protocol/pb/Ping.pb.h"
+#include "protocol/pb/TimeSyncResp.pb.h"
+
+#include <queue>
+
+#include <boost/filesystem.hpp>
+
+#include "logging/Log.h"
+#include "utilities/TimeUtil.h"
+#include "protocol/OpcodeHandler.h"
+#include "game/theater/TheaterManager.h"
+#include "game/world/World.h"
+#include "WorldSession.h"
+#include "PacketLatencyStats.h"
+
+SessionReplay::SessionReplay(std::unique_ptr<SessionRecordingReader>&& reader) :
+	m_reader(std::move(reader)),
+	m_session(nullptr),
+	m_isClosed(false)
+{
+}
+
+SessionReplay::~SessionReplay()
+{
+}
+
+void SessionReplay::deliver(WorldPacket&& packet)
+{
+	// The queue wait of the session is measured from the delivery, as it is for packets read from a socket
+	packet.setTimestamp(getSteadyTimeMicros());
+
+	try
+	{
+		switch (packet.getOpcode())
+		{
+		case MSG_PING:
+			this->handlePing(packet);
+			break;
+		case CMSG_TIME_SYNC_RESP:
+			this->handleTimeSyncResp(packet);
+			break;
+		case CMSG_AUTH_PROOF:
+			this->handleAuthProof(packet);
+			break;
+		default:
+		{
+			std::lock_guard<std::mutex> lock(m_sessMutex);
+			if (m_session && !m_isClosed)
+				m_session->addToRecvQueue(std::move(packet));
+			break;
+		}
+		}
+	}
+	catch (PacketException const&)
+	{
+		NS_LOG_ERROR("world.replay", "SessionReplay::deliver PacketException occurred while unpacking a packet (opcode: %u) of recording %s",
+			packet.getOpcode(), m_reader->getFileName().c_str());
+	}
+}
+
+bool SessionReplay::isReadyFor(uint16 opcode)
+{
+	SessionStatus status;
+	// The time synchronization starts when the session is accepted
+	if (opcode == CMSG_TIME_SYNC_RESP)
+		status = STATUS_AUTHED;
+	else
+	{
+		auto it = gOpcodeHandlerTable.find(opcode);
+		if (it == gOpcodeHandlerTable.end())
+			return true;
+		status = (*it).second.status;
+	}
+
+	std::lock_guard<std::mutex> lock(m_sessMutex);
+	if (!m_session || m_isClosed)
+		return true;
+
+	switch (status)
+	{
+	case STATUS_AUTHED:
+		return m_session->isAuthed();
+	case STATUS_LOGGEDIN:
+		return m_session->isLoggedIn();
+	default:
+		return true;
+	}
+}
+
+void SessionReplay::release()
+{
+	std::lock_guard<std::mutex> lock(m_sessMutex);
+	m_isClosed = true;
+	m_session = nullptr;
+}
+
+bool SessionReplay::hasSession()
+{
+	std::lock_guard<std::mutex> lock(m_sessMutex);
+	return m_session != nullptr;
+}
+
+void SessionReplay::handleAuthProof(WorldPacket& packet)
+{
+	AuthProof message;
+	packet.unpack(message);
+
+	std::lock_guard<std::mutex> lock(m_sessMutex);
+	if (m_isClosed)
+		return;
+
+	m_session = new WorldSession(this->shared_from_this());
+	m_session->setPlayerId(message.playerid());
+	m_session->setOriginalPlayerId(message.original_playerid());
+
+	if (message.session_id() > 0)
+		m_session->setSessionId(message.session_id());
+
+	m_session->setGMLevel(message.proof() == "GM" ? 1 : 0);
+	// There is no client to restore the session, so the player logs out when the recording ends
+	m_session->setRequiredCapabilities(message.required_capabilities() & ~REQUIRES_ALLOW_PLAYER_TO_RESTORE);
+
+	sTheaterManager->queueSession(m_session);
+}
+
+void SessionReplay::handlePing(WorldPacket& packet)
+{
+	Ping ping;
+	packet.unpack(ping);
+
+	std::lock_guard<std::mutex> lock(m_sessMutex);
+	if (!m_session)
+		return;
+
+	m_session->resetTimeoutTimer();
+	if (ping.latency() > 0)
+		m_session->setLatency(ping.latency());
+}
+
+void SessionReplay::handleTimeSyncResp(WorldPacket& packet)
+{
+	TimeSyncResp timeSync;
+	packet.unpack(timeSync);
+
+	std::lock_guard<std::mutex> lock(m_sessMutex);
+	if (m_session)
+		m_session->updateClientTime(timeSync.counter(), timeSync.time());
+}
+
+
+SessionReplayer::SessionReplayer() :
+	m_speed(1.0),
+	m_thread(nullptr),
+	m_isStopping(false)
+{
+}
+
+SessionReplayer::~SessionReplayer()
+{
+	this->stop();
+}
+
+SessionReplayer* SessionReplayer::instance()
+{
+	static SessionReplayer instance;
+	return &instance;
+}
+
+bool SessionReplayer::start(std::vector<std::string> const& paths, double speed)
+{
+	namespace fs = boost::filesystem;
+
+	m_speed = speed;
+	for (std::string const& path : paths)
+	{
+		boost::system::error_code error;
+		if (!fs::is_directory(path, error))
+		{
+			if (!this->addRecording(path))
+				return false;
+			continue;
+		}
+
+		std::vector<std::string> fileNames;
+		for (fs::directory_iterator it(path, error), end; !error && it != end; it.increment(error))
+		{
+			if (fs::is_regular_file((*it).path()) && (*it).path().extension() == ".rec")
+				fileNames.push_back((*it).path().string());
+		}
+
+		std::sort(fileNames.begin(), fileNames.end());
+		for (std::string const& fileName : fileNames)
+		{
+			if (!this->addRecording(fileName))
+				return false;
+		}
+	}
+
+	if (m_replays.empty())
+	{
+		NS_LOG_ERROR("world.replay", "No recordings to replay.");
+		return false;
+	}
+
+	m_thread = new std::thread(&SessionReplayer::run, this);
+
+	return true;
+}
+
+void SessionReplayer::stop()
+{
+	m_isStopping = true;
+	if (m_thread)
+	{
+		m_thread->join();
+		delete m_thread;
+		m_thread = nullptr;
+	}
+}
+
+bool SessionReplayer::addRecording(std::string const& fileName)
+{
+	std::unique_ptr<SessionRecordingReader> reader = std_extensions::make_unique<SessionRecordingReader>();
+	if (!reader->open(fileName))
+	{
+		NS_LOG_ERROR("world.replay", "Failed to open the recording %s", fileName.c_str());
+		return false;
+	}
+
+	m_replays.emplace_back(std::make_shared<SessionReplay>(std::move(reader)));
+
+	return true;
+}
+
+void SessionReplayer::run()
+{
+	// The time of an event is in microseconds since the start of the first recording
+	typedef std::pair<int64, size_t> Event;
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+	std::vector<WorldPacket> nextPackets(m_replays.size());
+
+	int64 firstStartTime = m_replays.front()->getReader().getStartTime();
+	for (auto const& replay : m_replays)
+		firstStartTime = std::min(firstStartTime, replay->getReader().getStartTime());
+
+	for (size_t i = 0; i < m_replays.size(); ++i)
+	{
+		int64 delay;
+		if (m_replays[i]->getReader().next(delay, nextPackets[i]))
+			events.emplace((m_replays[i]->getReader().getStartTime() - firstStartTime) * 1000 + delay, i);
+		else
+			m_replays[i]->close();
+	}
+
+	if (m_speed > 0.0)
+		NS_LOG_INFO("world.replay", "Replaying %u recordings at %gx speed", static_cast<uint32>(m_replays.size()), m_speed);
+	else
+		NS_LOG_INFO("world.replay", "Replaying %u recordings at maximum speed", static_cast<uint32>(m_replays.size()));
+
+	int64 replayStartTime = getSteadyTimeMicros();
+	uint64 packetCount = 0;
+	while (!events.empty() && !m_isStopping && !sWorld->isStopped())
+	{
+		Event event = events.top();
+		events.pop();
+
+		SessionReplay& replay = *m_replays[event.second];
+		WorldPacket& packet = nextPackets[event.second];
+		if (m_speed > 0.0)
+		{
+			// Sleep in short steps so that stopping the server is not delayed by long pauses of the recordings
+			int64 dueTime = replayStartTime + static_cast<int64>(event.first / m_speed);
+			for (int64 now = getSteadyTimeMicros(); now < dueTime && !m_isStopping; now = getSteadyTimeMicros())
+				std::this_thread::sleep_for(std::chrono::microseconds(std::min<int64>(dueTime - now, 100000)));
+		}
+		else if (!this->waitUntilReady(replay, packet.getOpcode()))
+			break;
+
+		replay.deliver(std::move(packet));
+		++packetCount;
+
+		int64 delay;
+		if (replay.getReader().next(delay, packet))
+			events.emplace(event.first + delay, event.second);
+		else
+			replay.close();
+	}
+
+	for (auto const& replay : m_replays)
+		replay->close();
+
+	int64 deliveredTime = getSteadyTimeMicros();
+	while (!m_isStopping && !sWorld->isStopped())
+	{
+		bool released = true;
+		for (auto const& replay : m_replays)
+		{
+			if (replay->hasSession())
+			{
+				released = false;
+				break;
+			}
+		}
+
+		if (released)
+			break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	int64 endTime = getSteadyTimeMicros();
+	double elapsed = (deliveredTime - replayStartTime) / 1000000.0;
+	NS_LOG_INFO("world.replay", "Replayed %llu packets of %u recordings in %.3f s (%.0f packets/s), the sessions were released %.3f s later",
+		static_cast<unsigned long long>(packetCount), static_cast<uint32>(m_replays.size()), elapsed,
+		elapsed > 0.0 ? packetCount / elapsed : 0.0, (endTime - deliveredTime) / 1000000.0);
+
+	if (sPacketLatencyStats->isEnabled())
+		NS_LOG_INFO("world.replay", "Packet latency stats:\n%s", sPacketLatencyStats->description().c_str());
+
+	sWorld->stopNow();
+}
+
+bool SessionReplayer::waitUntilReady(SessionReplay& replay, uint16 opcode)
+{
+	int64 deadline = getUptimeMillis() + READY_TIMEOUT;
+	while (!replay.isReadyFor(opcode))
+	{
+		if (m_isStopping || sWorld->isStopped())
+			return false;
+
+		if (getUptimeMillis() >= deadline)
+		{
+			NS_LOG_WARN("world.replay", "The session of recording %s was not ready for opcode %s within %d ms, the packet is delivered anyway",
+				replay.getReader().getFileName().c_str(), getOpcodeNameForLogging(opcode).c_str(), READY_TIMEOUT);
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return true;
+}
@@ -0,0 +1,83 @@
+#ifndef __SESSION_REPLAY_H__
+#define __SESSION_REPLAY_H__
+
+#include <atomic>
+#include <thread>
+
+#include "Common.h"
+#include "SessionRecorder.h"
+
+class WorldSession;
+
+// The replay of one recording file. It takes the place of the socket of the replayed session:
+// the packets that WorldSocket handles itself are handled here, and the other packets are added
+// to the receive queue of the session. The packets sent to the session are packed and discarded
+class SessionReplay : public std::enable_shared_from_this<SessionReplay>
+{
+public:
+	explicit SessionReplay(std::unique_ptr<SessionRecordingReader>&& reader);
+	~SessionReplay();
+
+	SessionRecordingReader& getReader() { return *m_reader; }
+	std::string const& getRemoteAddress() const { return m_reader->getRemoteAddress(); }
+	uint16 getRemotePort() const { return m_reader->getRemotePort(); }
+
+	void deliver(WorldPacket&& packet);
+	// Returns true if the session is in the state required by the handler of the opcode.
+	// Used when replaying as fast as possible, so packets are not dropped by handlers the original client waited for
+	bool isReadyFor(uint16 opcode);
+
+	// Stop delivering packets. The session logs out the player as if the client had disconnected
+	void close() { m_isClosed = true; }
+	bool isOpen() const { return !m_isClosed; }
+	// Called when the session is released
+	void release();
+	// Returns true until the session created by the recorded authentication has been released
+	bool hasSession();
+
+private:
+	void handleAuthProof(WorldPacket& packet);
+	void handlePing(WorldPacket& packet);
+	void handleTimeSyncResp(WorldPacket& packet);
+
+	std::unique_ptr<SessionRecordingReader> m_reader;
+	WorldSession* m_session;
+	std::mutex m_sessMutex;
+	std::atomic<bool> m_isClosed;
+};
+
+// Replays recording files of SessionRecorder into the sessions of a headless server, see the --replay command option.
+// The packets of all recordings are delivered in the order they were received, either at the recorded pace scaled by
+// the speed, or as fast as the sessions accept them. The world is stopped when all replayed sessions have been released
+class SessionReplayer
+{
+public:
+	enum
+	{
+		// When replaying as fast as possible, the longest time (in milliseconds) to wait for a session to be ready for a packet
+		READY_TIMEOUT = 5000
+	};
+
+	static SessionReplayer* instance();
+
+	// The paths are recording files or directories of recording files. A speed of 0 replays as fast as possible
+	bool start(std::vector<std::string> const& paths, double speed);
+	void stop();
+
+private:
+	SessionReplayer();
+	~SessionReplayer();
+
+	bool addRecording(std::string const& fileName);
+	void run();
+	bool waitUntilReady(SessionReplay& replay, uint16 opcode);
+
+	std::vector<std::shared_ptr<SessionReplay>> m_replays;
+	double m_speed;
+	std::thread* m_thread;
+	std::atomic<bool> m_isStopping;
+};
+
+#define sSessionReplayer SessionReplayer::instance()
+
+#endif // __SESSION_REPLAY_H__
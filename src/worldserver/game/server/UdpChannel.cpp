@@ -0,0 +1,88 @@
+#include "UdpChannel.h"
+
+#include "utilities/TimeUtil.h"
+#include "WorldSession.h"
+#include "UdpChannelMgr.h"
+
+UdpChannel::UdpChannel(WorldSession* session, uint32 sessionId, uint32 token) :
+	m_session(session),
+	m_sessionId(sessionId),
+	m_token(token),
+	m_isBound(false),
+	m_lastReceivedTime(0),
+	m_recvSequence(0),
+	m_sendSequence(0)
+{
+}
+
+void UdpChannel::detachSession()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_session = nullptr;
+}
+
+bool UdpChannel::isServerOpcode(uint16 opcode)
+{
+	switch (opcode)
+	{
+	case MSG_MOVE_SYNC:
+	case MSG_MOVE_HEARTBEAT:
+	case SMSG_RELOCATE_LOCATOR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool UdpChannel::isClientOpcode(uint16 opcode)
+{
+	return opcode == MSG_MOVE_HEARTBEAT;
+}
+
+bool UdpChannel::handleDatagram(boost::asio::ip::udp::endpoint const& endpoint, uint32 sequence, uint16 opcode, uint8 const* body, uint16 bodySize)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_session)
+		return false;
+
+	if (m_isBound && !isNewerSequence(sequence, m_recvSequence))
+		return false;
+
+	// The endpoint follows the client, e.g. after a NAT rebinding
+	m_endpoint = endpoint;
+	m_isBound = true;
+	m_recvSequence = sequence;
+	m_lastReceivedTime = getSteadyTimeMicros();
+
+	if (opcode == MSG_UDP_BIND)
+	{
+		sUdpChannelMgr->sendDatagram(endpoint, m_sessionId, m_token, ++m_sendSequence, MSG_UDP_BIND, nullptr, 0);
+		return true;
+	}
+
+	if (isClientOpcode(opcode))
+	{
+		WorldPacket packet(opcode);
+		packet.setBody(body, bodySize);
+		packet.setTimestamp(m_lastReceivedTime);
+		packet.setDatagramSequence(sequence);
+		m_session->addToRecvQueue(std::move(packet));
+	}
+
+	return true;
+}
+
+bool UdpChannel::prepareSend(boost::asio::ip::udp::endpoint& endpoint, uint32& sequence)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_isBound)
+		return false;
+
+	if (getSteadyTimeMicros() - m_lastReceivedTime > sUdpChannelMgr->getTimeout() * 1000)
+		return false;
+
+	endpoint = m_endpoint;
+	sequence = ++m_sendSequence;
+
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef __UDP_CHANNEL_H__
+#define __UDP_CHANNEL_H__
+
+#include <mutex>
+
+#include <boost/asio.hpp>
+
+#include "Common.h"
+#include "protocol/Opcode.h"
+
+class WorldSession;
+
+// Unreliable datagram channel of a session. It carries movement state that is superseded
+// by the next update (heartbeats, move syncs and locator relocations), so a lost datagram
+// is never resent and does not delay the packets behind it. All other traffic stays on
+// the TCP connection, which is also used for these opcodes until the channel is bound.
+//
+// Binding:
+//   1. The client sets REQUIRES_UDP_CHANNEL in the auth proof
+//   2. The server sends SMSG_UDP_CHANNEL_INFO over TCP, the body is the channel token
+//      (4 bytes) followed by the UDP port (2 bytes), big-endian
+//   3. The client sends MSG_UDP_BIND datagrams to the port until the server answers with MSG_UDP_BIND
+//
+// Each datagram starts with a header, big-endian:
+//   session id (4 bytes), token (4 bytes), sequence (4 bytes), opcode (2 bytes)
+// followed by the packet body. The sequence is incremented for each datagram sent in either
+// direction, and a datagram whose sequence is not newer than the last one received is discarded.
+// The channel falls back to TCP when no datagram has been received from the client for the timeout
+class UdpChannel
+{
+public:
+	enum
+	{
+		HEADER_BYTE_SIZE = 14,
+		// Larger packets are sent over TCP to avoid IP fragmentation
+		MAX_BODY_BYTE_SIZE = 1200
+	};
+
+	UdpChannel(WorldSession* session, uint32 sessionId, uint32 token);
+
+	uint32 getSessionId() const { return m_sessionId; }
+	uint32 getToken() const { return m_token; }
+
+	// Called when the session is released, no more packets are delivered to it afterwards
+	void detachSession();
+
+	// Returns true if the opcode may be sent over the channel in the specified direction
+	static bool isServerOpcode(uint16 opcode);
+	static bool isClientOpcode(uint16 opcode);
+
+	// Called by UdpChannelMgr for each datagram of the channel with a valid token.
+	// Returns false if the datagram is stale and was discarded
+	bool handleDatagram(boost::asio::ip::udp::endpoint const& endpoint, uint32 sequence, uint16 opcode, uint8 const* body, uint16 bodySize);
+
+	// Get the client endpoint and the sequence of the next datagram.
+	// Returns false if the channel is not bound or has timed out
+	bool prepareSend(boost::asio::ip::udp::endpoint& endpoint, uint32& sequence);
+
+private:
+	static bool isNewerSequence(uint32 sequence, uint32 last) { return static_cast<int32>(sequence - last) > 0; }
+
+	std::mutex m_mutex;
+	WorldSession* m_session;
+	uint32 const m_sessionId;
+	uint32 const m_token;
+
+	boost::asio::ip::udp::endpoint m_endpoint;
+	bool m_isBound;
+	int64 m_lastReceivedTime;
+	uint32 m_recvSequence;
+	uint32 m_sendSequence;
+};
+
+#endif // __UDP_CHANNEL_H__
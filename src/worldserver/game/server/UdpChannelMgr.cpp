@@ -0,0 +1,215 @@
+#include "UdpChannelMgr.h"
+
+#include <array>
+#include <random>
+
+#include "configuration/Config.h"
+#include "logging/Log.h"
+
+UdpChannelMgr::UdpChannelMgr() :
+	m_socket(nullptr),
+	m_port(0),
+	m_timeout(0),
+	m_lossRate(0.f),
+	m_receivedCount(0),
+	m_sentCount(0),
+	m_discardedCount(0)
+{
+}
+
+UdpChannelMgr::~UdpChannelMgr()
+{
+	this->stopNetwork();
+}
+
+UdpChannelMgr* UdpChannelMgr::instance()
+{
+	static UdpChannelMgr instance;
+	return &instance;
+}
+
+bool UdpChannelMgr::startNetwork(boost::asio::io_service& service, std::string const& bindIp, uint16 port)
+{
+	if (!sConfigMgr->getBoolDefault("Network.Udp.Enable", false))
+		return true;
+
+	m_timeout = std::max(sConfigMgr->getIntDefault("Network.Udp.Timeout", 5000), 0);
+	m_lossRate = std::min(std::max(sConfigMgr->getFloatDefault("Network.Udp.LossRate", 0.f), 0.f), 100.f);
+
+	boost::system::error_code ec;
+	boost::asio::ip::udp::endpoint endpoint(boost::asio::ip::address::from_string(bindIp, ec), port);
+	if (ec)
+	{
+		NS_LOG_ERROR("network.udp", "Invalid UDP bind address %s. err = %s", bindIp.c_str(), ec.message().c_str());
+		return false;
+	}
+
+	m_socket = new boost::asio::ip::udp::socket(service);
+	m_socket->open(endpoint.protocol(), ec);
+	if (!ec)
+		m_socket->bind(endpoint, ec);
+	if (!ec)
+		// Sends never block, a datagram that does not fit into the kernel buffer is lost like any other
+		m_socket->non_blocking(true, ec);
+	if (ec)
+	{
+		NS_LOG_ERROR("network.udp", "Failed to open UDP socket on %s:%d. err = %s", bindIp.c_str(), port, ec.message().c_str());
+		delete m_socket;
+		m_socket = nullptr;
+		return false;
+	}
+
+	m_port = port;
+	NS_LOG_INFO("network.udp", "UDP channel listening on %s:%d (loss rate %.1f%%)", bindIp.c_str(), port, m_lossRate);
+
+	this->asyncReceive();
+
+	return true;
+}
+
+void UdpChannelMgr::stopNetwork()
+{
+	if (!m_socket)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		boost::system::error_code ec;
+		m_socket->close(ec);
+		delete m_socket;
+		m_socket = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(m_channelsMutex);
+	m_channels.clear();
+}
+
+std::shared_ptr<UdpChannel> UdpChannelMgr::createChannel(WorldSession* session, uint32 sessionId)
+{
+	if (!this->isEnabled())
+		return nullptr;
+
+	static thread_local std::mt19937 engine{ std::random_device()() };
+	uint32 token = std::uniform_int_distribution<uint32>(1, std::numeric_limits<uint32>::max())(engine);
+	std::shared_ptr<UdpChannel> channel = std::make_shared<UdpChannel>(session, sessionId, token);
+
+	std::lock_guard<std::mutex> lock(m_channelsMutex);
+	// A restored session replaces the channel of the previous session with the same id
+	m_channels[sessionId] = channel;
+
+	return channel;
+}
+
+void UdpChannelMgr::removeChannel(std::shared_ptr<UdpChannel> const& channel)
+{
+	channel->detachSession();
+
+	std::lock_guard<std::mutex> lock(m_channelsMutex);
+	auto it = m_channels.find(channel->getSessionId());
+	if (it != m_channels.end() && (*it).second == channel)
+		m_channels.erase(it);
+}
+
+bool UdpChannelMgr::send(UdpChannel& channel, uint16 opcode, uint8 const* body, uint32 bodySize)
+{
+	if (!this->isEnabled() || bodySize > UdpChannel::MAX_BODY_BYTE_SIZE)
+		return false;
+
+	boost::asio::ip::udp::endpoint endpoint;
+	uint32 sequence;
+	if (!channel.prepareSend(endpoint, sequence))
+		return false;
+
+	this->sendDatagram(endpoint, channel.getSessionId(), channel.getToken(), sequence, opcode, body, bodySize);
+
+	return true;
+}
+
+void UdpChannelMgr::sendDatagram(boost::asio::ip::udp::endpoint const& endpoint, uint32 sessionId, uint32 token, uint32 sequence, uint16 opcode, uint8 const* body, uint16 bodySize)
+{
+	if (this->isLost())
+		return;
+
+	uint8 header[UdpChannel::HEADER_BYTE_SIZE];
+	uint8* writePtr = header;
+	for (uint32 value : { sessionId, token, sequence })
+	{
+		*(writePtr++) = 0xFF & (value >> 24);
+		*(writePtr++) = 0xFF & (value >> 16);
+		*(writePtr++) = 0xFF & (value >> 8);
+		*(writePtr++) = 0xFF & value;
+	}
+	*(writePtr++) = 0xFF & (opcode >> 8);
+	*(writePtr++) = 0xFF & opcode;
+
+	std::array<boost::asio::const_buffer, 2> buffers = {{
+		boost::asio::buffer(header, sizeof(header)),
+		boost::asio::buffer(body, bodySize)
+	}};
+
+	// The channels send from the theater threads, the socket object itself is not thread-safe
+	std::lock_guard<std::mutex> lock(m_sendMutex);
+	if (!m_socket)
+		return;
+
+	boost::system::error_code ec;
+	m_socket->send_to(buffers, endpoint, 0, ec);
+	if (!ec)
+		m_sentCount.fetch_add(1, std::memory_order_relaxed);
+	else if (ec != boost::asio::error::would_block)
+		NS_LOG_DEBUG("network.udp", "Failed to send datagram to %s:%d. err = %s", endpoint.address().to_string().c_str(), endpoint.port(), ec.message().c_str());
+}
+
+void UdpChannelMgr::asyncReceive()
+{
+	m_socket->async_receive_from(boost::asio::buffer(m_recvBuffer, RECEIVE_BUFFER_SIZE), m_senderEndpoint,
+		std::bind(&UdpChannelMgr::handleReceive, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void UdpChannelMgr::handleReceive(boost::system::error_code const& error, std::size_t transferredBytes)
+{
+	if (error == boost::asio::error::operation_aborted || !m_socket)
+		return;
+
+	if (!error && transferredBytes >= UdpChannel::HEADER_BYTE_SIZE && !this->isLost())
+	{
+		uint8 const* readPtr = m_recvBuffer;
+		uint32 values[3];
+		for (uint32& value : values)
+		{
+			value = (uint32(readPtr[0]) << 24) | (uint32(readPtr[1]) << 16) | (uint32(readPtr[2]) << 8) | uint32(readPtr[3]);
+			readPtr += 4;
+		}
+		uint16 opcode = static_cast<uint16>((readPtr[0] << 8) | readPtr[1]);
+		uint16 bodySize = static_cast<uint16>(transferredBytes - UdpChannel::HEADER_BYTE_SIZE);
+
+		std::shared_ptr<UdpChannel> channel;
+		{
+			std::lock_guard<std::mutex> lock(m_channelsMutex);
+			auto it = m_channels.find(values[0]);
+			if (it != m_channels.end())
+				channel = (*it).second;
+		}
+
+		// Datagrams with an unknown session, a wrong token or an opcode the client may not send are ignored
+		bool isValid = channel && channel->getToken() == values[1]
+			&& (opcode == MSG_UDP_BIND || UdpChannel::isClientOpcode(opcode))
+			&& bodySize <= UdpChannel::MAX_BODY_BYTE_SIZE;
+		if (isValid && channel->handleDatagram(m_senderEndpoint, values[2], opcode, m_recvBuffer + UdpChannel::HEADER_BYTE_SIZE, bodySize))
+			m_receivedCount.fetch_add(1, std::memory_order_relaxed);
+		else
+			m_discardedCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	this->asyncReceive();
+}
+
+bool UdpChannelMgr::isLost() const
+{
+	if (m_lossRate <= 0.f)
+		return false;
+
+	// Datagrams are sent from several threads, each uses its own engine
+	static thread_local std::mt19937 engine{ std::random_device()() };
+	return std::uniform_real_distribution<float>(0.f, 100.f)(engine) < m_lossRate;
+}
@@ -0,0 +1,74 @@
+#ifndef __UDP_CHANNEL_MGR_H__
+#define __UDP_CHANNEL_MGR_H__
+
+#include <atomic>
+#include <unordered_map>
+
+#include <boost/asio.hpp>
+
+#include "UdpChannel.h"
+
+// Owns the UDP socket shared by all session channels and dispatches the received
+// datagrams to the channels by session id. See UdpChannel for the datagram format
+class UdpChannelMgr
+{
+public:
+	enum
+	{
+		RECEIVE_BUFFER_SIZE = 2048
+	};
+
+	static UdpChannelMgr* instance();
+
+	bool startNetwork(boost::asio::io_service& service, std::string const& bindIp, uint16 port);
+	void stopNetwork();
+	bool isEnabled() const { return m_socket != nullptr; }
+
+	// Create a channel for the session and register it under the session id.
+	// Returns nullptr if the UDP channel is disabled
+	std::shared_ptr<UdpChannel> createChannel(WorldSession* session, uint32 sessionId);
+	void removeChannel(std::shared_ptr<UdpChannel> const& channel);
+
+	// Send a packet over the channel. Returns false if the channel is not bound or the
+	// packet is too large, in which case the caller should send it over TCP
+	bool send(UdpChannel& channel, uint16 opcode, uint8 const* body, uint32 bodySize);
+	void sendDatagram(boost::asio::ip::udp::endpoint const& endpoint, uint32 sessionId, uint32 token, uint32 sequence, uint16 opcode, uint8 const* body, uint16 bodySize);
+
+	uint16 getPort() const { return m_port; }
+	// The time (in milliseconds) without datagrams from the client after which the channel falls back to TCP
+	int32 getTimeout() const { return m_timeout; }
+
+	uint64 getReceivedCount() const { return m_receivedCount.load(std::memory_order_relaxed); }
+	uint64 getSentCount() const { return m_sentCount.load(std::memory_order_relaxed); }
+	uint64 getDiscardedCount() const { return m_discardedCount.load(std::memory_order_relaxed); }
+
+private:
+	UdpChannelMgr();
+	~UdpChannelMgr();
+
+	void asyncReceive();
+	void handleReceive(boost::system::error_code const& error, std::size_t transferredBytes);
+
+	// Simulated packet loss for testing, see Network.Udp.LossRate
+	bool isLost() const;
+
+	boost::asio::ip::udp::socket* m_socket;
+	boost::asio::ip::udp::endpoint m_senderEndpoint;
+	uint8 m_recvBuffer[RECEIVE_BUFFER_SIZE];
+	std::mutex m_sendMutex;
+
+	std::mutex m_channelsMutex;
+	std::unordered_map<uint32, std::shared_ptr<UdpChannel> > m_channels;
+
+	uint16 m_port;
+	int32 m_timeout;
+	float m_lossRate;
+
+	std::atomic<uint64> m_receivedCount;
+	std::atomic<uint64> m_sentCount;
+	std::atomic<uint64> m_discardedCount;
+};
+
+#define sUdpChannelMgr UdpChannelMgr::instance()
+
+#endif // __UDP_CHANNEL_MGR_H__
@@ -7,17 +7,32 @@
 #include "protocol/OpcodeHandler.h"
 #include "game/behaviors/Player.h"
 #include "game/theater/Theater.h"
+#include "game/theater/TheaterManager.h"
 #include "WorldSocket.h"
+#include "UdpChannelMgr.h"
+#include "SessionReplay.h"
+#include "PacketLatencyStats.h"
 
 
 #define TIME_SYNC_INTERVAL			10000 // Time synchronization interval. Unit: milliseconds
 
-WorldSession::WorldSession(std::shared_ptr<WorldSocket> const& socket):
+WorldSession::WorldSession(std::shared_ptr<WorldSocket> const& socket) :
+	WorldSession(socket->getRemoteAddress().to_string(), socket->getRemotePort())
+{
+	m_socket = socket;
+}
+
+WorldSession::WorldSession(std::shared_ptr<SessionReplay> const& replay) :
+	WorldSession(replay->getRemoteAddress(), replay->getRemotePort())
+{
+	m_replay = replay;
+}
+
+WorldSession::WorldSession(std::string const& remoteAddress, uint16 remotePort) :
 	m_sessionId(0),
-	m_remoteAddress(socket->getRemoteAddress().to_string()),
-	m_remotePort(socket->getRemotePort()),
+	m_remoteAddress(remoteAddress),
+	m_remotePort(remotePort),
 	m_theater(nullptr),
-	m_socket(socket),
 	m_isInQueue(false),
 	m_isLoggingOut(false),
 	m_isLogoutAfterDisconnected(false),
@@ -32,7 +47,12 @@ WorldSession::WorldSession(std::shared_ptr<WorldSocket> const& socket):
 	m_timeSyncServer(0),
 	m_timeSyncCounter(0),
 	m_timeoutTimer(0),
-	m_timeoutTime(SESSION_TIMEOUT_NEVER)
+	m_timeoutTime(SESSION_TIMEOUT_NEVER),
+	m_lastMovementReceiveTime(0),
+	m_hasStreamMovement(false),
+	m_lastStreamMovementTime(0),
+	m_hasDatagramMovement(false),
+	m_lastDatagramSequence(0)
 {
 }
 
@@ -44,9 +64,30 @@ WorldSession::~WorldSession()
 		m_socket = nullptr;
 	}
 
+	if (m_replay)
+	{
+		m_replay->release();
+		m_replay = nullptr;
+	}
+
+	if (m_udpChannel)
+	{
+		sUdpChannelMgr->removeChannel(m_udpChannel);
+		m_udpChannel = nullptr;
+	}
+
 	m_theater = nullptr;
 }
 
+namespace
+{
+	bool isThreadSafePacket(WorldPacket const& packet)
+	{
+		auto it = gOpcodeHandlerTable.find(packet.getOpcode());
+		return it != gOpcodeHandlerTable.end() && (*it).second.processing == PROCESS_THREADSAFE;
+	}
+}
+
 void WorldSession::addToRecvQueue(WorldPacket&& newPacket)
 {
 	m_recvQueue.add(std::move(newPacket));
@@ -54,13 +95,15 @@ void WorldSession::addToRecvQueue(WorldPacket&& newPacket)
 
 void WorldSession::packAndSend(WorldPacket&& packet, MessageLite const& message)
 {
-	if (!m_socket || !m_socket->isOpen())
+	if (!this->isConnected())
 		return;
 
+	// The send latency is measured from here, so it includes the serialization of the message
+	packet.setTimestamp(getSteadyTimeMicros());
 	try
 	{
 		packet.pack(message);
-		m_socket->queuePacket(std::move(packet));
+		this->sendPacket(std::move(packet));
 	}
 	catch (PacketException const& ex)
 	{
@@ -69,6 +112,51 @@ void WorldSession::packAndSend(WorldPacket&& packet, MessageLite const& message)
 	}																			
 }
 
+void WorldSession::sendSharedPacket(uint16 opcode, SharedPayloadPtr const& payload)
+{
+	if (!this->isConnected())
+		return;
+
+	if (payload->getSize() > WorldPacket::MAX_STREAM_BYTE_SIZE)
+	{
+		NS_LOG_ERROR("world.session", "Sending to client %s:%d failed because the shared packet (opcode: %u, size: %u) exceeds MAX_STREAM_BYTE_SIZE(%d), sessionid=%u.",
+			m_remoteAddress.c_str(), m_remotePort, opcode, payload->getSize(), WorldPacket::MAX_STREAM_BYTE_SIZE, this->getSessionId());
+		return;
+	}
+
+	WorldPacket packet(opcode);
+	packet.setTimestamp(getSteadyTimeMicros());
+	packet.setSharedBody(payload);
+	this->sendPacket(std::move(packet));
+}
+
+void WorldSession::sendPacket(WorldPacket&& packet)
+{
+	if (packet.getFrameCount() > 1 && !this->isRequiresCapability(REQUIRES_STREAMING))
+	{
+		NS_LOG_ERROR("world.session", "Sending to client %s:%d failed because the packet (opcode: %u, size: %u) exceeds a frame and the client does not accept streaming, sessionid=%u.",
+			m_remoteAddress.c_str(), m_remotePort, packet.getOpcode(), packet.getBodyBytes(), this->getSessionId());
+		return;
+	}
+
+	// Superseding movement state is sent over the UDP channel once the client has bound it
+	if (m_udpChannel && UdpChannel::isServerOpcode(packet.getOpcode())
+		&& sUdpChannelMgr->send(*m_udpChannel, packet.getOpcode(), packet.getBodyData(), packet.getBodyBytes()))
+		return;
+
+	// A replayed session has no socket, its packets are packed but not sent
+	if (m_socket)
+		m_socket->queuePacket(std::move(packet));
+}
+
+bool WorldSession::isConnected() const
+{
+	if (m_replay)
+		return m_replay->isOpen();
+
+	return m_socket && m_socket->isOpen();
+}
+
 uint32 WorldSession::getTheaterId() const
 {
 	if (m_theater)
@@ -85,6 +173,9 @@ void WorldSession::kickPlayer()
 	if (m_socket)
 		m_socket->closeSocket();
 
+	if (m_replay)
+		m_replay->close();
+
 	m_isLoggingOut = true;
 }
 
@@ -128,42 +219,22 @@ bool WorldSession::update(NSTime diff)
 		this->kickPlayer();
 	}
 
+	// Of a session in a theater, the world thread stops at the first packet the theater handles,
+	// so the packets are still handled in the order they were received. The packets of a disconnected
+	// session are all handled here, before the player is logged out
+	bool isProcessedByTheater = this->isConnected() && this->isProcessedByTheater();
 	WorldPacket packet;
-	while (m_recvQueue.next(packet))
+	for (WorldPacket* next = m_recvQueue.peek(); next; next = m_recvQueue.peek())
 	{
-		try
-		{
-			// Call the handler corresponding to the opcode to process the protocol data
-			if (gOpcodeHandlerTable.find(packet.getOpcode()) != gOpcodeHandlerTable.end())
-			{
-				OpcodeHandler& opHandler = gOpcodeHandlerTable[packet.getOpcode()];
-				switch (opHandler.status)
-				{
-				case STATUS_AUTHED:
-					if (m_isAuthed)
-						(this->*opHandler.handler)(packet);
-					break;
-				case STATUS_LOGGEDIN:
-					if (m_player)
-						(this->*opHandler.handler)(packet);
-					break;
-				default:
-					break;
-				}
-			}
-			else
-				NS_LOG_ERROR("world.session", "Received unhandled opcode %s from %s:%d"
-					, getOpcodeNameForLogging(packet.getOpcode()).c_str(), m_remoteAddress.c_str(), m_remotePort);
-		}
-		catch (PacketException const&)
-		{
-			NS_LOG_ERROR("world.session", "WorldSession::Update PacketException occurred while unpacking a packet (opcode: %u) from client %s:%d, sessionid=%u. Skipped packet.",
-				packet.getOpcode(), m_remoteAddress.c_str(), m_remotePort, this->getSessionId());
-		}
+		if (isProcessedByTheater && isThreadSafePacket(*next))
+			break;
+
+		m_recvQueue.next(packet);
+		this->handlePacket(packet);
 	}
 	
 
-	if (!m_socket || !m_socket->isOpen())
+	if (!this->isConnected())
 	{
 		if (!m_player || m_isLoggingOut || m_isLogoutAfterDisconnected)
 		{
@@ -190,6 +261,68 @@ bool WorldSession::update(NSTime diff)
 	return true;
 }
 
+void WorldSession::processThreadSafePackets()
+{
+	WorldPacket packet;
+	for (WorldPacket* next = m_recvQueue.peek(); next && isThreadSafePacket(*next); next = m_recvQueue.peek())
+	{
+		m_recvQueue.next(packet);
+		this->handlePacket(packet);
+	}
+}
+
+bool WorldSession::isProcessedByTheater() const
+{
+	if (!m_player || !m_theater || !sTheaterManager->isProcessingPacketsInTheaters())
+		return false;
+
+	// The session is updated by the theater only while the theater holds it
+	auto it = m_theater->getSessionList().find(m_sessionId);
+	return it != m_theater->getSessionList().end() && (*it).second == this;
+}
+
+void WorldSession::handlePacket(WorldPacket& packet)
+{
+	bool isLatencyEnabled = sPacketLatencyStats->isEnabled();
+	try
+	{
+		// Call the handler corresponding to the opcode to process the protocol data
+		if (gOpcodeHandlerTable.find(packet.getOpcode()) != gOpcodeHandlerTable.end())
+		{
+			uint16 opcode = packet.getOpcode();
+			int64 startTime = isLatencyEnabled ? getSteadyTimeMicros() : 0;
+			if (isLatencyEnabled && packet.getTimestamp() > 0)
+				sPacketLatencyStats->add(PACKET_LATENCY_QUEUE_WAIT, opcode, startTime - packet.getTimestamp());
+
+			OpcodeHandler& opHandler = gOpcodeHandlerTable[opcode];
+			switch (opHandler.status)
+			{
+			case STATUS_AUTHED:
+				if (m_isAuthed)
+					(this->*opHandler.handler)(packet);
+				break;
+			case STATUS_LOGGEDIN:
+				if (m_player)
+					(this->*opHandler.handler)(packet);
+				break;
+			default:
+				break;
+			}
+
+			if (isLatencyEnabled)
+				sPacketLatencyStats->add(PACKET_LATENCY_HANDLER, opcode, getSteadyTimeMicros() - startTime);
+		}
+		else
+			NS_LOG_ERROR("world.session", "Received unhandled opcode %s from %s:%d"
+				, getOpcodeNameForLogging(packet.getOpcode()).c_str(), m_remoteAddress.c_str(), m_remotePort);
+	}
+	catch (PacketException const&)
+	{
+		NS_LOG_ERROR("world.session", "WorldSession::handlePacket PacketException occurred while unpacking a packet (opcode: %u) from client %s:%d, sessionid=%u. Skipped packet.",
+			packet.getOpcode(), m_remoteAddress.c_str(), m_remotePort, this->getSessionId());
+	}
+}
+
 void WorldSession::sendAuthVerdict(AuthVerdict::AuthResult result, int32 waitPos)
 {
 	AuthVerdict message;
@@ -212,6 +345,27 @@ void WorldSession::onSessionAccepted()
 	this->sendTimeSync();
 
 	this->sendAuthVerdict(AuthVerdict::AUTH_OK);
+
+	if (!m_udpChannel && this->isRequiresCapability(REQUIRES_UDP_CHANNEL))
+		this->openUdpChannel();
+}
+
+void WorldSession::openUdpChannel()
+{
+	m_udpChannel = sUdpChannelMgr->createChannel(this, m_sessionId);
+	if (!m_udpChannel || !m_socket || !m_socket->isOpen())
+		return;
+
+	uint32 token = m_udpChannel->getToken();
+	uint16 port = sUdpChannelMgr->getPort();
+	uint8 body[6] = {
+		uint8(0xFF & (token >> 24)), uint8(0xFF & (token >> 16)), uint8(0xFF & (token >> 8)), uint8(0xFF & token),
+		uint8(0xFF & (port >> 8)), uint8(0xFF & port)
+	};
+
+	WorldPacket packet(SMSG_UDP_CHANNEL_INFO);
+	packet.setBody(body, sizeof(body));
+	m_socket->queuePacket(std::move(packet));
 }
 
 void WorldSession::onSessionAccepted(WorldSession* oldSession)
@@ -6,10 +6,12 @@
 #include "protocol/pb/PlayerActionMessage.pb.h"
 
 #include "utilities/Timer.h"
-#include "containers/ConcurrentQueue.h"
+#include "containers/MPSCQueue.h"
 #include "WorldSocket.h"
+#include "UdpChannel.h"
 
 class WorldSocket;
+class SessionReplay;
 class Unit;
 class Player;
 class Theater;
@@ -18,7 +20,13 @@ enum RequiredCapabilities
 {
 	// If a player disconnects without requesting to log out, the server will allow 
 	// the player to restore the connection within the timeout time
-	REQUIRES_ALLOW_PLAYER_TO_RESTORE		= 0x00000001
+	REQUIRES_ALLOW_PLAYER_TO_RESTORE		= 0x00000001,
+	// The client accepts compressed packets (see BasicPacket::COMPRESSED_OPCODE_FLAG)
+	REQUIRES_COMPRESSION					= 0x00000002,
+	// The client opens a UDP channel for movement state (see UdpChannel)
+	REQUIRES_UDP_CHANNEL					= 0x00000004,
+	// The client accepts packets streamed across continuation frames (see BasicPacket::CONTINUATION_OPCODE_FLAG)
+	REQUIRES_STREAMING						= 0x00000008
 };
 
 enum LatencyIndex
@@ -39,10 +47,15 @@ public:
 	};
 
 	explicit WorldSession(std::shared_ptr<WorldSocket> const& socket);
+	// Create a session driven by a recording instead of a client connection, see SessionReplayer
+	explicit WorldSession(std::shared_ptr<SessionReplay> const& replay);
 	~WorldSession();
 
 	void addToRecvQueue(WorldPacket&& newPacket);
 	void packAndSend(WorldPacket&& packet, MessageLite const& message);
+	// Send a packet whose body is shared with packets sent to other sessions. 
+	// The packet is checked and sent the same way as by packAndSend()
+	void sendSharedPacket(uint16 opcode, SharedPayloadPtr const& payload);
 
 	void setSessionId(uint32 id) { m_sessionId = id; }
 	uint32 getSessionId() const { return m_sessionId; }
@@ -71,18 +84,24 @@ public:
 	// Kick the player. The server will immediately disconnect and log out the player 
 	// after processing the remaining messages in the receive queue
 	void kickPlayer();
-	bool isConnected() const { return m_socket && m_socket->isOpen(); }
+	bool isConnected() const;
 	// Log out the player and wait for the client to disconnect. 
 	// If the wait process times out, the server will actively disconnect
 	void logoutPlayer();
 	bool isLoggedIn() const { return m_player != nullptr; }
+	bool isAuthed() const { return m_isAuthed; }
 	// Log out the player after the client disconnects, otherwise the player will log out after 
 	// the session timeout or after calling the logoutPlayer() function
 	void setLogoutAfterDisconnected(bool logout) { m_isLogoutAfterDisconnected = logout; }
 
-	// Update the session. When the session is queued to join the theater, 
-	// it is updated by the main thread. Once it joins the theater, it is updated by the theater thread
+	// Update the session. The session is updated by the world thread. Once the player is in a theater, 
+	// the packets the theater handles are left in the receive queue for processThreadSafePackets()
 	bool update(NSTime diff);
+	// Handle the received packets of PROCESS_THREADSAFE opcodes up to the next packet of another opcode.
+	// Called by the update of the theater of the session
+	void processThreadSafePackets();
+	// Returns true if the received packets of PROCESS_THREADSAFE opcodes are handled by the update of the theater
+	bool isProcessedByTheater() const;
 
 	// Login authentication
 	void sendAuthVerdict(AuthVerdict::AuthResult result, int32 waitPos = 0);
@@ -154,7 +173,15 @@ public:
 	void handleUseItem(WorldPacket& recvPacket);
 
 private:
+	WorldSession(std::string const& remoteAddress, uint16 remotePort);
+
+	void handlePacket(WorldPacket& packet);
+	// Send a packed packet to the client. Checks that the client accepts the packet and picks the channel
+	void sendPacket(WorldPacket&& packet);
+
 	void updateAvgLatency();
+	// Create the UDP channel and send its token and port to the client
+	void openUdpChannel();
 
 	uint32 m_sessionId;
 	std::string m_remoteAddress;
@@ -163,7 +190,9 @@ private:
 	Theater* m_theater;
 
 	std::shared_ptr<WorldSocket> m_socket;
-	ConcurrentQueue<WorldPacket> m_recvQueue;
+	std::shared_ptr<SessionReplay> m_replay;
+	std::shared_ptr<UdpChannel> m_udpChannel;
+	MPSCQueue<WorldPacket> m_recvQueue;
 	bool m_isInQueue;
 
 	bool m_isLoggingOut;
@@ -188,6 +217,13 @@ private:
 
 	std::atomic<NSTime> m_timeoutTimer;
 	NSTime m_timeoutTime;
+
+	// The last movement packets accepted from the client, see handleMovementInfo()
+	int64 m_lastMovementReceiveTime;
+	bool m_hasStreamMovement;
+	int32 m_lastStreamMovementTime;
+	bool m_hasDatagramMovement;
+	uint32 m_lastDatagramSequence;
 };
 
 #endif //__WORLD_SESSION_H__
\ No newline at end of file
@@ -7,14 +7,20 @@
 #include "protocol/pb/Ping.pb.h"
 #include "protocol/pb/AuthProof.pb.h"
 
+#include <zlib.h>
+
 #include "utilities/TimeUtil.h"
 #include "protocol/Opcode.h"
 #include "game/theater/TheaterManager.h"
 #include "WorldSession.h"
+#include "WorldSocketMgr.h"
+#include "SessionRecorder.h"
+#include "PacketLatencyStats.h"
 
 WorldSocket::WorldSocket(tcp::socket&& socket) :
 	Socket(std::move(socket)),
-	m_session(nullptr)
+	m_session(nullptr),
+	m_isCompressionEnabled(false)
 {
 }
 
@@ -24,12 +30,17 @@ WorldSocket::~WorldSocket()
 
 void WorldSocket::start()
 {
+	m_recording = sSessionRecorder->createRecording(this->getRemoteAddress().to_string(), this->getRemotePort());
+
 	this->checkIP();
 }
 
 
 void WorldSocket::onReceivedData(WorldPacket&& packet)
 {
+	if (m_recording)
+		m_recording->record(packet);
+
 	std::unique_lock<std::mutex> sessLock(m_sessMutex, std::defer_lock);
 	try
 	{
@@ -61,6 +72,33 @@ void WorldSocket::onReceivedData(WorldPacket&& packet)
 	}
 }
 
+void WorldSocket::onReceivedPackets(std::vector<WorldPacket>& packets)
+{
+	// Consecutive packets for the session are added under a single lock
+	std::unique_lock<std::mutex> sessLock(m_sessMutex, std::defer_lock);
+	for (WorldPacket& packet : packets)
+	{
+		switch (packet.getOpcode())
+		{
+		case MSG_PING:
+		case CMSG_TIME_SYNC_RESP:
+		case CMSG_AUTH_PROOF:
+			if (sessLock.owns_lock())
+				sessLock.unlock();
+			this->onReceivedData(std::move(packet));
+			break;
+		default:
+			if (m_recording)
+				m_recording->record(packet);
+			if (!sessLock.owns_lock())
+				sessLock.lock();
+			if (m_session)
+				m_session->addToRecvQueue(std::move(packet));
+			break;
+		}
+	}
+}
+
 // When onSocketClosed() is called, the WorldSession object may already have been released, 
 // so no references to m_session should be made here
 void WorldSocket::onSocketClosed()
@@ -69,6 +107,107 @@ void WorldSocket::onSocketClosed()
 	m_session = nullptr;
 }
 
+SendLane WorldSocket::getSendLane(WorldPacket const& packet) const
+{
+	// Positions are sent again with the next heartbeat or relocation, so these can be dropped under pressure
+	switch (packet.getOpcode())
+	{
+	case MSG_MOVE_HEARTBEAT:
+	case SMSG_RELOCATE_LOCATOR:
+		return SEND_LANE_DROPPABLE;
+	default:
+		return SEND_LANE_RELIABLE;
+	}
+}
+
+// Compress the body of a packet split into frames
+static int compressFrames(WorldPacket const& packet, uint8* dest, uLongf* destLen, int level)
+{
+	// The same zlib stream as compress2() produces, fed with the body of one frame at a time
+	z_stream stream;
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+	int result = deflateInit(&stream, level);
+	if (result != Z_OK)
+		return result;
+
+	stream.next_out = dest;
+	stream.avail_out = static_cast<uInt>(*destLen);
+
+	uint32 frameCount = packet.getFrameCount();
+	for (uint32 i = 0; i < frameCount && result == Z_OK; ++i)
+	{
+		stream.next_in = const_cast<Bytef*>(packet.getFrameBodyData(i));
+		stream.avail_in = packet.getFrameBodyBytes(i);
+		result = deflate(&stream, i + 1 < frameCount ? Z_NO_FLUSH : Z_FINISH);
+	}
+
+	*destLen = stream.total_out;
+	deflateEnd(&stream);
+
+	return result == Z_STREAM_END ? Z_OK : (result == Z_OK ? Z_BUF_ERROR : result);
+}
+
+void WorldSocket::compressPacket(WorldPacket& packet)
+{
+	if (!m_isCompressionEnabled || !isCompressibleOpcode(packet.getOpcode()))
+		return;
+
+	CompressionSettings const& settings = sWorldSocketMgr->getCompressionSettings();
+	uLong bodyBytes = packet.getBodyBytes();
+	if (bodyBytes < static_cast<uLong>(settings.threshold))
+		return;
+
+	static thread_local std::vector<uint8> buffer;
+	uLongf compressedBytes = compressBound(bodyBytes);
+	buffer.resize(sizeof(uint32) + compressedBytes);
+
+	int result;
+	if (packet.getFrameCount() == 1)
+		result = compress2(buffer.data() + sizeof(uint32), &compressedBytes, packet.getBodyData(), bodyBytes, settings.level);
+	else
+		result = compressFrames(packet, buffer.data() + sizeof(uint32), &compressedBytes, settings.level);
+	if (result != Z_OK)
+	{
+		NS_LOG_ERROR("world.socket", "Failed to compress packet (opcode: %u, size: %u). zlib error: %d", packet.getOpcode(), packet.getBodyBytes(), result);
+		return;
+	}
+
+	// Send the packet uncompressed if compression does not make it smaller
+	uLong totalBytes = sizeof(uint32) + compressedBytes;
+	if (totalBytes >= bodyBytes)
+		return;
+
+	buffer[0] = 0xFF & (bodyBytes >> 24);
+	buffer[1] = 0xFF & (bodyBytes >> 16);
+	buffer[2] = 0xFF & (bodyBytes >> 8);
+	buffer[3] = 0xFF & bodyBytes;
+
+	packet.setBody(buffer.data(), static_cast<uint32>(totalBytes));
+	packet.setOpcode(packet.getOpcode() | WorldPacket::COMPRESSED_OPCODE_FLAG);
+	sNetworkStats->addCompressed(static_cast<uint32>(bodyBytes), static_cast<uint32>(totalBytes));
+}
+
+void WorldSocket::onPacketWritten(WorldPacket const& packet, int64 latency)
+{
+	if (sPacketLatencyStats->isEnabled())
+		sPacketLatencyStats->add(PACKET_LATENCY_SEND, packet.getOpcode() & ~WorldPacket::COMPRESSED_OPCODE_FLAG, latency);
+}
+
+bool WorldSocket::isCompressibleOpcode(uint16 opcode)
+{
+	switch (opcode)
+	{
+	case SMSG_UPDATE_OBJECT:
+	case SMSG_PLAYER_STATUS_LIST:
+	case SMSG_THEATER_STATUS_LIST:
+		return true;
+	default:
+		return false;
+	}
+}
+
 void WorldSocket::checkIP()
 {
 	// TODO If the IP is not on the blacklist, initiate a authentication request
@@ -116,6 +255,7 @@ void WorldSocket::handleAuthProof(WorldPacket& packet)
 		this->setSendQueueLimit(SEND_QUEUE_UNLIMITED);
 
 	m_session->setRequiredCapabilities(requiredCapabilities);
+	m_isCompressionEnabled = sWorldSocketMgr->getCompressionSettings().enabled && m_session->isRequiresCapability(REQUIRES_COMPRESSION);
 
 	sTheaterManager->queueSession(m_session);
 }
@@ -146,6 +286,8 @@ void WorldSocket::handlePing(WorldPacket& packet)
 
 void WorldSocket::packAndSend(WorldPacket&& packet, MessageLite const& message)
 {
+	// The packet may be a received one reused for the reply, so the receive time is replaced
+	packet.setTimestamp(getSteadyTimeMicros());
 	try
 	{
 		packet.pack(message);
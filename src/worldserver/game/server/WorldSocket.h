@@ -5,9 +5,21 @@
 #include "protocol/Opcode.h"
 
 class WorldSession;
+class SessionRecording;
 
 typedef BasicPacket<NUM_MSG_TYPES> WorldPacket;
 
+struct CompressionSettings
+{
+	CompressionSettings() : enabled(false), threshold(0), level(0) { }
+
+	bool enabled;
+	// Bodies smaller than this (in bytes) are not compressed
+	int32 threshold;
+	// zlib compression level 1-9
+	int32 level;
+};
+
 class WorldSocket : public Socket<WorldSocket, WorldPacket>
 {
 public:
@@ -16,7 +28,11 @@ public:
 
 	void start() override;
 	void onReceivedData(WorldPacket&& packet) override;
+	void onReceivedPackets(std::vector<WorldPacket>& packets) override;
 	void onSocketClosed() override;
+	SendLane getSendLane(WorldPacket const& packet) const override;
+	void compressPacket(WorldPacket& packet) override;
+	void onPacketWritten(WorldPacket const& packet, int64 latency) override;
 
 private:
 	void checkIP();
@@ -32,9 +48,17 @@ private:
 	// Time synchronization
 	void handleTimeSyncResp(WorldPacket & recvPacket);
 
+	// Returns true if packets with the opcode are compressed when they exceed the threshold
+	static bool isCompressibleOpcode(uint16 opcode);
+
 	WorldSession* m_session;
 	std::mutex m_sessMutex;
 
+	// Set when the client has negotiated compression, used only in the network thread
+	bool m_isCompressionEnabled;
+	// The inbound packets are recorded if SessionRecorder is enabled, used only in the network thread
+	std::unique_ptr<SessionRecording> m_recording;
+
 
 };
 
@@ -1,7 +1,32 @@
 #include "WorldSocketMgr.h"
 
+#include "UdpChannelMgr.h"
+#include "SessionRecorder.h"
+
 WorldSocketMgr* WorldSocketMgr::instance()
 {
 	static WorldSocketMgr instance;
 	return &instance;
-}
\ No newline at end of file
+}
+
+bool WorldSocketMgr::startNetwork(boost::asio::io_service& service, std::string const& bindIp, uint16 port, uint32 threadCount)
+{
+	m_compressionSettings.enabled = sConfigMgr->getBoolDefault("Network.Compression.Enable", true);
+	m_compressionSettings.threshold = sConfigMgr->getIntDefault("Network.Compression.Threshold", 256);
+	m_compressionSettings.level = std::min(std::max(sConfigMgr->getIntDefault("Network.Compression.Level", 6), 1), 9);
+
+	sSessionRecorder->loadConfig();
+
+	if (!SocketMgr<WorldSocket>::startNetwork(service, bindIp, port, threadCount))
+		return false;
+
+	// The UDP channel listens on the same port number as the TCP acceptor
+	return sUdpChannelMgr->startNetwork(service, bindIp, port);
+}
+
+void WorldSocketMgr::stopNetwork()
+{
+	sUdpChannelMgr->stopNetwork();
+
+	SocketMgr<WorldSocket>::stopNetwork();
+}
@@ -9,7 +9,14 @@ class WorldSocketMgr : public SocketMgr<WorldSocket>
 public:
 	static WorldSocketMgr* instance();
 
+	bool startNetwork(boost::asio::io_service& service, std::string const& bindIp, uint16 port, uint32 threadCount) override;
+	void stopNetwork() override;
+
+	// The settings are loaded when the network starts and are read-only afterwards
+	CompressionSettings const& getCompressionSettings() const { return m_compressionSettings; }
+
 protected:
+	CompressionSettings m_compressionSettings;
 };
 
 
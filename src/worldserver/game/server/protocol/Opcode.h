@@ -54,6 +54,8 @@ enum Opcode
 	SMSG_ITEM_APPLICATION_UPDATE_ALL,
 	SMSG_ITEM_COOLDOWN_LIST,
 	SMSG_ITEM_ACTION_MESSAGE,
+	SMSG_UDP_CHANNEL_INFO,
+	MSG_UDP_BIND,
 	NUM_MSG_TYPES
 };
 
@@ -56,29 +56,31 @@ char const* gOpcodeNameTable[NUM_MSG_TYPES] = {
 	"SMSG_ITEM_APPLICATION_UPDATE_ALL",
 	"SMSG_ITEM_COOLDOWN_LIST",
 	"SMSG_ITEM_ACTION_MESSAGE",
+	"SMSG_UDP_CHANNEL_INFO",
+	"MSG_UDP_BIND",
 };
 
 // World Opcode Handlers
 std::unordered_map<uint16, OpcodeHandler> gOpcodeHandlerTable = 
 {
-	{ CMSG_PLAYER_LOGIN,					{ STATUS_AUTHED,		&WorldSession::handlePlayerLogin				} },
-	{ CMSG_PLAYER_LOGOUT,					{ STATUS_LOGGEDIN,		&WorldSession::handlePlayerLogout				} },
-	{ CMSG_JOIN_THEATER,					{ STATUS_AUTHED,		&WorldSession::handleJoinTheater				} },
-	{ CMSG_QUERY_CHARACTER_INFO,			{ STATUS_LOGGEDIN,		&WorldSession::handleQueryCharacterInfo			} },
-	{ MSG_MOVE_START,						{ STATUS_LOGGEDIN,		&WorldSession::handleMovementInfo				} },
-	{ MSG_MOVE_SYNC,						{ STATUS_LOGGEDIN,		&WorldSession::handleMovementInfo				} },
-	{ MSG_MOVE_HEARTBEAT,					{ STATUS_LOGGEDIN,		&WorldSession::handleMovementInfo				} },
-	{ MSG_MOVE_TURN,						{ STATUS_LOGGEDIN,		&WorldSession::handleMovementInfo				} },
-	{ MSG_MOVE_STOP,						{ STATUS_LOGGEDIN,		&WorldSession::handleMovementInfo				} },
-	{ CMSG_ATTACK,							{ STATUS_LOGGEDIN,		&WorldSession::handleAttackInfo					} },
-	{ MSG_CHARGE_START,						{ STATUS_LOGGEDIN,		&WorldSession::handleStaminaInfo				} },
-	{ MSG_CHARGE_STOP,						{ STATUS_LOGGEDIN,		&WorldSession::handleStaminaInfo				} },
-	{ MSG_STAMINA_SYNC,						{ STATUS_LOGGEDIN,		&WorldSession::handleStaminaInfo				} },
-	{ CMSG_QUERY_WORLD_STATUS,				{ STATUS_LOGGEDIN,		&WorldSession::handleQueryWorldStatus			} },
-	{ CMSG_QUERY_THEATER_STATUS_LIST,		{ STATUS_LOGGEDIN,		&WorldSession::handleQueryTheaterStatusList		} },
-	{ CMSG_SMILEY_CHAT,						{ STATUS_LOGGEDIN,		&WorldSession::handleSmileyChat					} },
-	{ CMSG_QUERY_PLAYER_STATUS_LIST,		{ STATUS_LOGGEDIN,		&WorldSession::handleQueryPlayerStatusList		} },
-	{ CMSG_GM_COMMAND,						{ STATUS_LOGGEDIN,		&WorldSession::handleGMCommand					} },
-	{ CMSG_USE_ITEM,						{ STATUS_LOGGEDIN,		&WorldSession::handleUseItem					} },
+	{ CMSG_PLAYER_LOGIN,					{ STATUS_AUTHED,		PROCESS_THREADUNSAFE,	&WorldSession::handlePlayerLogin				} },
+	{ CMSG_PLAYER_LOGOUT,					{ STATUS_LOGGEDIN,		PROCESS_THREADUNSAFE,	&WorldSession::handlePlayerLogout				} },
+	{ CMSG_JOIN_THEATER,					{ STATUS_AUTHED,		PROCESS_THREADUNSAFE,	&WorldSession::handleJoinTheater				} },
+	{ CMSG_QUERY_CHARACTER_INFO,			{ STATUS_LOGGEDIN,		PROCESS_THREADUNSAFE,	&WorldSession::handleQueryCharacterInfo			} },
+	{ MSG_MOVE_START,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleMovementInfo				} },
+	{ MSG_MOVE_SYNC,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleMovementInfo				} },
+	{ MSG_MOVE_HEARTBEAT,					{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleMovementInfo				} },
+	{ MSG_MOVE_TURN,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleMovementInfo				} },
+	{ MSG_MOVE_STOP,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleMovementInfo				} },
+	{ CMSG_ATTACK,							{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleAttackInfo					} },
+	{ MSG_CHARGE_START,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleStaminaInfo				} },
+	{ MSG_CHARGE_STOP,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleStaminaInfo				} },
+	{ MSG_STAMINA_SYNC,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleStaminaInfo				} },
+	{ CMSG_QUERY_WORLD_STATUS,				{ STATUS_LOGGEDIN,		PROCESS_THREADUNSAFE,	&WorldSession::handleQueryWorldStatus			} },
+	{ CMSG_QUERY_THEATER_STATUS_LIST,		{ STATUS_LOGGEDIN,		PROCESS_THREADUNSAFE,	&WorldSession::handleQueryTheaterStatusList		} },
+	{ CMSG_SMILEY_CHAT,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleSmileyChat					} },
+	{ CMSG_QUERY_PLAYER_STATUS_LIST,		{ STATUS_LOGGEDIN,		PROCESS_THREADUNSAFE,	&WorldSession::handleQueryPlayerStatusList		} },
+	{ CMSG_GM_COMMAND,						{ STATUS_LOGGEDIN,		PROCESS_THREADUNSAFE,	&WorldSession::handleGMCommand					} },
+	{ CMSG_USE_ITEM,						{ STATUS_LOGGEDIN,		PROCESS_THREADSAFE,		&WorldSession::handleUseItem					} },
 };
 
@@ -15,9 +15,16 @@ enum SessionStatus
 	STATUS_LOGGEDIN,                                        // The player has logged in to the game (m_player != NULL)
 };
 
+enum PacketProcessing
+{
+	PROCESS_THREADUNSAFE = 0,                               // Handled by the world thread
+	PROCESS_THREADSAFE,                                     // Only touches the theater of the player, handled by the update of the theater
+};
+
 struct OpcodeHandler
 {
 	SessionStatus status;
+	PacketProcessing processing;
 	void (WorldSession::*handler)(WorldPacket& recvPacket);
 };
 
@@ -3,6 +3,7 @@
 #include "game/server/protocol/pb/WaitForPlayers.pb.h"
 
 #include "utilities/Random.h"
+#include "utilities/StringUtil.h"
 #include "utilities/TimeUtil.h"
 #include "game/maps/MapDataManager.h"
 #include "game/behaviors/Player.h"
@@ -19,6 +20,9 @@ Theater::Theater(uint32 theaterId) :
 	m_map(nullptr),
 	m_spawnManager(new SpawnManager()),
 	m_updateDiff(0),
+	m_lastUpdateTime(0),
+	m_expectedUpdateTime(0),
+	m_overBudgetTicks(0),
 	m_isDeleting(false),
 	m_deletionDelay(0),
 	m_deletionStartTime(0)
@@ -231,6 +235,70 @@ void Theater::advancedUpdate(NSTime diff)
 }
 
 void Theater::update(NSTime diff)
+{
+	int64 startTime = getSteadyTimeMicros();
+
+	MapUpdateProfile* profile = m_map ? &m_map->getUpdateProfile() : nullptr;
+	if (profile)
+		profile->beginTick();
+
+	{
+		MapUpdatePhaseTimer phaseTimer(profile);
+		phaseTimer.start(MAP_UPDATE_PHASE_PACKETS);
+		for (auto it = m_sessions.begin(); it != m_sessions.end(); ++it)
+		{
+			WorldSession* session = (*it).second;
+			if (session->isProcessedByTheater())
+				session->processThreadSafePackets();
+		}
+	}
+
+	this->updateState(diff);
+
+	// Exponential moving average with a weight of 1/8 for the last update
+	m_lastUpdateTime = getSteadyTimeMicros() - startTime;
+	m_expectedUpdateTime += (m_lastUpdateTime - m_expectedUpdateTime) / 8;
+}
+
+bool Theater::checkTickBudget(int64 budget)
+{
+	if (m_lastUpdateTime <= budget)
+	{
+		if (m_overBudgetTicks > 0)
+		{
+			NS_LOG_INFO("world.theater", "Theater(ID: %u) is back within the tick budget after %u ticks. Expected update time: %lld us",
+				m_theaterId, m_overBudgetTicks, static_cast<long long>(m_expectedUpdateTime));
+			m_overBudgetTicks = 0;
+		}
+		return false;
+	}
+
+	// The time outside the phases is mostly spent starting and stopping the battle
+	std::string phases = "not profiled";
+	if (m_map && m_map->getUpdateProfile().isEnabled())
+	{
+		MapUpdateProfile const& profile = m_map->getUpdateProfile();
+		phases = StringUtil::format("%s, other: %lldus", profile.describeLastTick().c_str(),
+			static_cast<long long>(std::max<int64>(m_lastUpdateTime - profile.getLastTickTime(), 0)));
+	}
+
+	// Only the first tick over the budget is logged as a warning, until the theater is back within the budget
+	if (m_overBudgetTicks++ == 0)
+	{
+		NS_LOG_WARN("world.theater", "Theater(ID: %u) exceeded the tick budget of %lld us: %lld us. Expected update time: %lld us, Players: %d, Phases: %s",
+			m_theaterId, static_cast<long long>(budget), static_cast<long long>(m_lastUpdateTime),
+			static_cast<long long>(m_expectedUpdateTime), this->getOnlineCount(), phases.c_str());
+	}
+	else
+	{
+		NS_LOG_DEBUG("world.theater", "Theater(ID: %u) exceeded the tick budget of %lld us: %lld us. Phases: %s",
+			m_theaterId, static_cast<long long>(budget), static_cast<long long>(m_lastUpdateTime), phases.c_str());
+	}
+
+	return true;
+}
+
+void Theater::updateState(NSTime diff)
 {
 	if (!m_map)
 		return;
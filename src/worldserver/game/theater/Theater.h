@@ -55,6 +55,14 @@ public:
 	void update(NSTime diff);
 	NSTime getUpdateDiff() const { return m_updateDiff; }
 
+	// The time (in microseconds) the last update took, and the moving average of the recent updates
+	int64 getLastUpdateTime() const { return m_lastUpdateTime; }
+	int64 getExpectedUpdateTime() const { return m_expectedUpdateTime; }
+	// Called after the update of the tick. Returns true if the update took longer than the budget (in microseconds)
+	bool checkTickBudget(int64 budget);
+	bool isOverBudget() const { return m_overBudgetTicks > 0; }
+	uint32 getOverBudgetTicks() const { return m_overBudgetTicks; }
+
 	void setDeletionDelay(NSTime delay);
 	bool canDelete() const;
 	bool isDeleting() const { return m_isDeleting; }
@@ -66,6 +74,8 @@ private:
 	bool createMapIfNotExistForPlayer(WorldSession* session);
 	void configureMapForPlayer(WorldSession* session);
 
+	void updateState(NSTime diff);
+
 	bool isSleepState() const { return this->getOnlineCount() <= 0 && m_state == STATE_IDLE; }
 
 	uint32 m_theaterId;
@@ -80,6 +90,9 @@ private:
 	BattleMap* m_map;
 	SpawnManager* m_spawnManager;
 	NSTime m_updateDiff;
+	int64 m_lastUpdateTime;
+	int64 m_expectedUpdateTime;
+	uint32 m_overBudgetTicks;
 
 	bool m_isDeleting;
 	NSTime m_deletionDelay;
@@ -18,7 +18,10 @@ TheaterManager::TheaterManager():
 	m_waitForPlayersTimeout(0),
 	m_sessionTimeout(0),
 	m_expiredSessionDelay(0),
-	m_queuedSessionTimeout(0)
+	m_queuedSessionTimeout(0),
+	m_theaterTickBudget(0),
+	m_isProcessingPacketsInTheaters(false),
+	m_serialSessionCount(0)
 {
 
 }
@@ -62,7 +65,10 @@ void TheaterManager::initialize()
 	m_waitForPlayersTimeout = sConfigMgr->getIntDefault("WaitForPlayersTimeout", 5000);
 
 	int32 updateThreads = sConfigMgr->getIntDefault("TheaterUpdateThreads", 1);
-	m_updater.start(updateThreads);
+	m_updater.setFlushBarrierEnabled(sConfigMgr->getBoolDefault("TheaterUpdateThreads.FlushBarrier", true));
+	m_updater.start(updateThreads, std::max(sConfigMgr->getIntDefault("TheaterUpdateThreads.SpinTime", 0), 0));
+	m_isProcessingPacketsInTheaters = sConfigMgr->getBoolDefault("TheaterUpdateThreads.ProcessPackets", true);
+	m_theaterTickBudget = std::max(sConfigMgr->getIntDefault("TheaterTickBudget", 25), 0) * 1000;
 
 	m_sessionTimeout = sConfigMgr->getIntDefault("SessionTimeout", 60000);
 	m_expiredSessionDelay = sConfigMgr->getIntDefault("ExpiredSessionDelay", 5000);
@@ -141,9 +147,14 @@ void TheaterManager::addGMSession(WorldSession* session)
 
 void TheaterManager::updateSessions(NSTime diff)
 {
+	int64 startTime = getSteadyTimeMicros();
+	int32 serialSessionCount = 0;
 	for (auto it = m_sessions.begin(); it != m_sessions.end();)
 	{
 		WorldSession* session = (*it).second;
+		if (!session->isProcessedByTheater())
+			++serialSessionCount;
+
 		if (!session->update(diff))
 		{
 			if (session->hasGMPermission())
@@ -159,6 +170,9 @@ void TheaterManager::updateSessions(NSTime diff)
 			++it;
 		}
 	}
+
+	m_serialSessionCount = serialSessionCount;
+	m_sessionUpdateTime.add(getSteadyTimeMicros() - startTime);
 }
 
 void TheaterManager::queueSession(WorldSession* session)
@@ -314,11 +328,22 @@ void TheaterManager::updateTheaters(NSTime diff)
 		theater->advancedUpdate(diff);
 	}
 
-	for (Theater* theater : m_orderedTheaters)
+	// Each worker runs its newest task first and the workers are only woken once the whole tick is queued, so the 
+	// theaters are scheduled from the cheapest to the most expensive and the most expensive theaters are updated 
+	// first, instead of stretching the tick when they start last
+	m_scheduledTheaters.assign(m_orderedTheaters.begin(), m_orderedTheaters.end());
+	std::stable_sort(m_scheduledTheaters.begin(), m_scheduledTheaters.end(), [](Theater const* a, Theater const* b) {
+		return a->getExpectedUpdateTime() < b->getExpectedUpdateTime();
+	});
+
+	m_updater.scheduleUpdates(diff, m_scheduledTheaters);
+	m_updater.waitUpdate();
+
+	if (m_theaterTickBudget > 0)
 	{
-		m_updater.scheduleUpdate(diff, theater);
+		for (Theater* theater : m_scheduledTheaters)
+			theater->checkTickBudget(m_theaterTickBudget);
 	}
-	m_updater.waitUpdate();
 }
 
 void TheaterManager::processPendingSessions()
@@ -5,6 +5,7 @@
 
 #include "Common.h"
 #include "utilities/Timer.h"
+#include "utilities/Histogram.h"
 #include "game/server/WorldSession.h"
 #include "Theater.h"
 #include "TheaterUpdater.h"
@@ -43,6 +44,15 @@ public:
 	// Returns false when the theater service is completely stopped
 	bool update(NSTime diff);
 
+	// If enabled, the packets of PROCESS_THREADSAFE opcodes received by the sessions in a theater
+	// are handled by the update of the theater instead of by the world thread
+	bool isProcessingPacketsInTheaters() const { return m_isProcessingPacketsInTheaters; }
+	// The time (in microseconds) the world thread spends updating the sessions in each tick
+	Histogram const& getSessionUpdateTime() const { return m_sessionUpdateTime; }
+	void resetSessionUpdateTime() { m_sessionUpdateTime.reset(); }
+	// The number of sessions whose packets were all handled by the world thread in the last tick
+	int32 getSerialSessionCount() const { return m_serialSessionCount; }
+
 private:
 	TheaterManager();
 	~TheaterManager();
@@ -74,13 +84,18 @@ private:
 	TheaterUpdater m_updater;
 	TheaterMap m_theaters;
 	OrderedTheaterList m_orderedTheaters;
+	OrderedTheaterList m_scheduledTheaters;
+	int64 m_theaterTickBudget;
+	bool m_isProcessingPacketsInTheaters;
+	Histogram m_sessionUpdateTime;
+	std::atomic<int32> m_serialSessionCount;
 	int32 m_playerLimit;
 	int32 m_playerCount;
 	int32 m_gmCount;
 	NSTime m_theaterDeletionDelay;
 	NSTime m_waitForPlayersTimeout;
 
-	ConcurrentQueue<WorldSession*> m_pendingSessions;
+	MPSCQueue<WorldSession*> m_pendingSessions;
 	SessionMap m_sessions;
 	SessionList m_queuedPlayers;
 	SessionList m_expiredPlayers;
@@ -1,34 +1,23 @@
 #include "TheaterUpdater.h"
 
 #include "utilities/Util.h"
+#include "utilities/TimeUtil.h"
+#include "threading/ThreadAffinity.h"
 
-TheaterUpdateTask::TheaterUpdateTask() :
-	m_theater(nullptr),
-	m_diff(0),
-	m_updater(nullptr)
+namespace
 {
-
-}
-
-TheaterUpdateTask::TheaterUpdateTask(Theater* theater, NSTime diff, TheaterUpdater* updater) :
-	m_theater(theater),
-	m_diff(diff),
-	m_updater(updater)
-{
-
-}
-
-void TheaterUpdateTask::execute()
-{
-	m_theater->update(m_diff);
-	m_updater->updateFinished();
+	// The updater and the queue of the calling worker thread
+	thread_local TheaterUpdater const* tUpdater = nullptr;
+	thread_local uint32 tWorkerIndex = 0;
 }
 
-
-
 TheaterUpdater::TheaterUpdater() :
 	m_isStopped(true),
-	m_pendingTasks(0)
+	m_spinTime(0),
+	m_isFlushBarrierEnabled(false),
+	m_nextQueue(0),
+	m_queuedTasks(0),
+	m_idleWorkers(0)
 {
 
 }
@@ -38,40 +27,96 @@ TheaterUpdater::~TheaterUpdater()
 	this->stop();
 }
 
-void TheaterUpdater::start(uint32 numThreads)
+void TheaterUpdater::start(uint32 numThreads, int32 spinTime)
 {
 	if (!m_isStopped.exchange(false))
 		return;
 
+	m_spinTime = spinTime;
+
+	// Without workers the tasks are queued for waitUpdate() to run them
+	for (uint32 i = 0; i < std::max<uint32>(numThreads, 1); i++)
+		m_queues.push_back(std_extensions::make_unique<WorkerQueue>());
+
 	for (uint32 i = 0; i < numThreads; i++)
 	{
-		m_threadPool.push_back(std::thread(&TheaterUpdater::workerThread, this));
+		m_threadPool.push_back(std::thread(&TheaterUpdater::workerThread, this, i));
 	}
 }
 
 void TheaterUpdater::waitUpdate()
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_threadPool.empty())
+	{
+		QueuedTask task;
+		while (this->findTask(this->getWorkerIndex(), task))
+			this->runTask(task);
+	}
+
+	if (!m_pendingTasks.isDone())
+	{
+		std::unique_lock<std::mutex> lock(m_waitMutex);
+		while (!m_pendingTasks.isDone() && !m_isStopped)
+			m_waitCondition.wait(lock);
+	}
 
-	while (m_pendingTasks > 0)
-		m_condition.wait(lock);
+	// All theaters of the tick have been updated
+	if (m_isFlushBarrierEnabled)
+		m_flushBarrier.release();
 }
 
 void TheaterUpdater::scheduleUpdate(NSTime diff, Theater* theater)
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-	++m_pendingTasks;
+	this->submit([theater, diff]() { theater->update(diff); });
+}
 
-	m_updateQueue.push(TheaterUpdateTask(theater, diff, this));
+void TheaterUpdater::scheduleUpdates(NSTime diff, std::vector<Theater*> const& theaters)
+{
+	if (theaters.empty())
+		return;
+
+	uint32 numQueues = static_cast<uint32>(m_queues.size());
+	uint32 firstQueue = m_nextQueue.fetch_add(static_cast<uint32>(theaters.size()), std::memory_order_relaxed);
+	for (uint32 i = 0; i < numQueues && i < theaters.size(); ++i)
+	{
+		WorkerQueue& queue = *m_queues[(firstQueue + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (std::size_t j = i; j < theaters.size(); j += numQueues)
+		{
+			Theater* theater = theaters[j];
+			m_pendingTasks.add();
+			m_queuedTasks.fetch_add(1);
+			queue.tasks.push_back(QueuedTask([theater, diff]() { theater->update(diff); }, nullptr));
+		}
+	}
+
+	this->wakeWorkers(true);
 }
 
-void TheaterUpdater::updateFinished()
+void TheaterUpdater::submit(Task&& task, TaskLatch* latch)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	if (latch)
+		latch->add();
+	m_pendingTasks.add();
+
+	uint32 index = this->getWorkerIndex();
+	if (index >= m_queues.size())
+		index = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
 
-	--m_pendingTasks;
+	this->pushTask(index, QueuedTask(std::move(task), latch));
+}
 
-	m_condition.notify_all();
+void TheaterUpdater::wait(TaskLatch& latch)
+{
+	uint32 index = this->getWorkerIndex();
+	while (!latch.isDone())
+	{
+		QueuedTask task;
+		if (this->findTask(index, task))
+			this->runTask(task);
+		else
+			cpuRelax();
+	}
 }
 
 
@@ -80,31 +125,201 @@ void TheaterUpdater::stop()
 	if (m_isStopped.exchange(true))
 		return;
 
-	NS_LOG_INFO("world.theater", "TheaterUpdater is stopping. PendingTasks: %d", m_pendingTasks);
+	NS_LOG_INFO("world.theater", "TheaterUpdater is stopping. PendingTasks: %u", m_pendingTasks.getCount());
 
-	std::unique_lock<std::mutex> lock(m_mutex);
-	m_pendingTasks = 0;
-	m_condition.notify_all();
-
-	lock.unlock();
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_idleCondition.notify_all();
+	}
 
-	m_updateQueue.cancel();
 	for (auto& thread : m_threadPool)
 	{
 		thread.join();
 	}
 	m_threadPool.clear();
+
+	// The tasks that have not run are dropped
+	for (auto const& queue : m_queues)
+	{
+		for (QueuedTask& task : queue->tasks)
+		{
+			if (task.latch)
+				task.latch->countDown();
+			m_pendingTasks.countDown();
+		}
+	}
+	m_queues.clear();
+	m_queuedTasks = 0;
+
+	std::lock_guard<std::mutex> lock(m_waitMutex);
+	m_waitCondition.notify_all();
 }
 
-void TheaterUpdater::workerThread()
+void TheaterUpdater::workerThread(uint32 index)
 {
+	pinCurrentThread("TheaterUpdateThreads.Cores", index, "world.theater");
+
+	tUpdater = this;
+	tWorkerIndex = index;
+
 	while (!m_isStopped)
 	{
-		TheaterUpdateTask task;
+		QueuedTask task;
 
-		if(m_updateQueue.waitAndPop(task))
-			task.execute();
+		if (this->popTask(index, task))
+			this->runTask(task);
 	}
 
-	NS_LOG_DEBUG("world.theater", "TheaterUpdater worker thread(ID=%s) has exited. QueueSize: %zu", getCurrentThreadId().c_str(), m_updateQueue.size());
+	NS_LOG_DEBUG("world.theater", "TheaterUpdater worker thread(ID=%s) has exited. QueueSize: %zu", getCurrentThreadId().c_str(), m_queues[index]->tasks.size());
+}
+
+uint32 TheaterUpdater::getWorkerIndex() const
+{
+	return tUpdater == this ? tWorkerIndex : static_cast<uint32>(m_queues.size());
+}
+
+void TheaterUpdater::pushTask(uint32 index, QueuedTask&& task)
+{
+	m_queuedTasks.fetch_add(1);
+
+	WorkerQueue& queue = *m_queues[index];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	// A single idle worker is woken per task, the others keep sleeping
+	this->wakeWorkers(false);
+}
+
+void TheaterUpdater::wakeWorkers(bool all)
+{
+	if (m_idleWorkers.load() == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_idleMutex);
+	if (all)
+		m_idleCondition.notify_all();
+	else
+		m_idleCondition.notify_one();
+}
+
+bool TheaterUpdater::popTask(uint32 index, QueuedTask& task)
+{
+	if (this->findTask(index, task))
+		return true;
+
+	// The tasks of a tick arrive in quick succession, so a short spin 
+	// usually finds the next one without sleeping on the condition variable
+	if (m_spinTime > 0)
+	{
+		int64 spinEnd = getSteadyTimeMicros() + m_spinTime;
+		do
+		{
+			cpuRelax();
+
+			if (this->findTask(index, task))
+				return true;
+		} while (!m_isStopped && getSteadyTimeMicros() < spinEnd);
+	}
+
+	this->waitForTask(index);
+
+	return false;
+}
+
+bool TheaterUpdater::findTask(uint32 index, QueuedTask& task)
+{
+	if (m_queuedTasks.load(std::memory_order_relaxed) == 0)
+		return false;
+
+	// The newest task of the own queue is taken first, its data is most likely still in the cache
+	if (index < m_queues.size())
+	{
+		WorkerQueue& queue = *m_queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			m_queuedTasks.fetch_sub(1);
+			return true;
+		}
+	}
+
+	// Otherwise the newest task of another queue is stolen. The updates of a tick are queued from the cheapest to the 
+	// most expensive theater, so like the owner, a spinning worker takes the most expensive theater left in the queue
+	// A busy queue is skipped at first. If the tasks could only be in busy queues, they are locked in turn, otherwise
+	// the worker would spin on them, since waitForTask() does not block while tasks are queued
+	uint32 numQueues = static_cast<uint32>(m_queues.size());
+	bool isContended = false;
+	for (int32 pass = 0; pass < 2; ++pass)
+	{
+		for (uint32 i = 1; i <= numQueues; ++i)
+		{
+			uint32 victim = (index + i) % numQueues;
+			if (victim == index)
+				continue;
+
+			WorkerQueue& queue = *m_queues[victim];
+			std::unique_lock<std::mutex> lock(queue.mutex, std::defer_lock);
+			if (pass == 0)
+			{
+				if (!lock.try_lock())
+				{
+					isContended = true;
+					continue;
+				}
+			}
+			else
+				lock.lock();
+
+			if (queue.tasks.empty())
+				continue;
+
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			m_queuedTasks.fetch_sub(1);
+			return true;
+		}
+
+		if (!isContended)
+			break;
+	}
+
+	return false;
+}
+
+void TheaterUpdater::waitForTask(uint32 index)
+{
+	std::unique_lock<std::mutex> lock(m_idleMutex);
+
+	// Registered as idle before the queued tasks are checked, so a task queued in between always wakes a worker
+	m_idleWorkers.fetch_add(1);
+	while (m_queuedTasks.load() == 0 && !m_isStopped)
+		m_idleCondition.wait(lock);
+	m_idleWorkers.fetch_sub(1);
+}
+
+void TheaterUpdater::runTask(QueuedTask& task)
+{
+	// A task run while another task waits for its sub-tasks must not leave the barrier of the waiting task
+	FlushBarrier* barrier = this->getFlushBarrier();
+	bool isEntered = barrier && FlushBarrier::getCurrent() != barrier;
+	if (isEntered)
+		barrier->enter();
+
+	task.task();
+
+	if (isEntered)
+		barrier->leave();
+
+	if (task.latch)
+		task.latch->countDown();
+
+	if (m_pendingTasks.countDown())
+	{
+		std::lock_guard<std::mutex> lock(m_waitMutex);
+		m_waitCondition.notify_one();
+	}
 }
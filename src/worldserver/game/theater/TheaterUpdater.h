@@ -1,50 +1,112 @@
 #ifndef __THEATER_UPDATER_H__
 #define __THEATER_UPDATER_H__
 
+#include <deque>
+
 #include "Common.h"
-#include "containers/BlockingQueue.h"
+#include "networking/FlushBarrier.h"
 #include "Theater.h"
 
-class TheaterUpdater;
-
-class TheaterUpdateTask
+// Counts the unfinished tasks of a group. A task submitted with a latch counts it down when it has run
+class TaskLatch
 {
 public:
-	TheaterUpdateTask();
-	TheaterUpdateTask(Theater* theater, NSTime diff, TheaterUpdater* updater);
+	TaskLatch() : m_count(0) {}
+
+	void add() { m_count.fetch_add(1, std::memory_order_relaxed); }
+	// Returns true if the last unfinished task of the group has finished
+	bool countDown() { return m_count.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+	bool isDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+	uint32 getCount() const { return m_count.load(std::memory_order_relaxed); }
 
-	void execute();
 private:
-	Theater* m_theater;
-	NSTime m_diff;
-	TheaterUpdater* m_updater;
+	std::atomic<uint32> m_count;
 };
 
+// Updates the theaters of a tick on a pool of threads. Each worker has its own task queue, which is a std::deque
+// guarded by a mutex rather than a lock-free deque, since a tick only queues a few tasks per theater. The worker
+// takes its newest task first and an idle worker steals the newest task of another queue. A task can
+// submit sub-tasks to the pool, they are queued on the worker that runs it and picked up by the idle workers
 class TheaterUpdater
 {
 public:
+	typedef std::function<void()> Task;
+
 	TheaterUpdater();
 	~TheaterUpdater();
 
-	void start(uint32 numThreads);
+	// The spin time (in microseconds) is how long an idle worker keeps polling 
+	// the queues before it blocks, 0 blocks right away
+	void start(uint32 numThreads, int32 spinTime = 0);
 	void stop();
 
+	// If enabled, the packets queued during the update of the theaters are flushed after waitUpdate(),
+	// once per socket, instead of by the network threads while the theaters are still being updated
+	void setFlushBarrierEnabled(bool enabled) { m_isFlushBarrierEnabled = enabled; }
+	FlushBarrier* getFlushBarrier() { return m_isFlushBarrierEnabled ? &m_flushBarrier : nullptr; }
+
+	// Wait until all tasks scheduled or submitted since the last call have finished
 	void waitUpdate();
 	void scheduleUpdate(NSTime diff, Theater* theater);
-	void updateFinished();
+	// Schedule the updates of all theaters of a tick. The theaters are dealt to the queues in turn and all of 
+	// them are queued before the idle workers are woken, so each worker starts with the last theater of its share
+	void scheduleUpdates(NSTime diff, std::vector<Theater*> const& theaters);
+
+	// Submit a task to the pool. If a latch is specified, it counts the task until the task has run. 
+	// Called by a worker, the task is queued on the worker itself
+	void submit(Task&& task, TaskLatch* latch = nullptr);
+	// Wait until all tasks of the latch have run. The calling thread runs queued tasks in the meantime,
+	// so a task can wait for its sub-tasks without blocking a worker
+	void wait(TaskLatch& latch);
 
 private:
-	void workerThread();
+	struct QueuedTask
+	{
+		QueuedTask() : latch(nullptr) {}
+		QueuedTask(Task&& task, TaskLatch* latch) : task(std::move(task)), latch(latch) {}
+
+		Task task;
+		TaskLatch* latch;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<QueuedTask> tasks;
+	};
+
+	void workerThread(uint32 index);
+	// Returns the index of the queue of the calling worker, or the number of queues if the caller is not a worker
+	uint32 getWorkerIndex() const;
+	void pushTask(uint32 index, QueuedTask&& task);
+	void wakeWorkers(bool all);
+	bool popTask(uint32 index, QueuedTask& task);
+	bool findTask(uint32 index, QueuedTask& task);
+	void waitForTask(uint32 index);
+	void runTask(QueuedTask& task);
 
 	std::atomic<bool> m_isStopped;
+	int32 m_spinTime;
+	bool m_isFlushBarrierEnabled;
+	FlushBarrier m_flushBarrier;
 
 	std::vector<std::thread> m_threadPool;
-	BlockingQueue<TheaterUpdateTask> m_updateQueue;
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::atomic<uint32> m_nextQueue;
+	// The tasks in the queues. Incremented before a task is queued, so it never underflows
+	std::atomic<uint32> m_queuedTasks;
+
+	// The idle workers block on the condition until a task is queued. A queued task wakes one of them,
+	// a batch of scheduled updates wakes all of them
+	std::mutex m_idleMutex;
+	std::condition_variable m_idleCondition;
+	std::atomic<uint32> m_idleWorkers;
 
-	std::mutex m_mutex;
-	std::condition_variable m_condition;
-	uint32 m_pendingTasks;
+	// Counts all unfinished tasks. Only the task that finishes last wakes waitUpdate()
+	TaskLatch m_pendingTasks;
+	std::mutex m_waitMutex;
+	std::condition_variable m_waitCondition;
 };
 
 
-#endif //__THEATER_UPDATER_H__
\ No newline at end of file
+#endif //__THEATER_UPDATER_H__
@@ -4,6 +4,7 @@
 #include "configuration/Config.h"
 #include "game/theater/TheaterManager.h"
 #include "game/maps/MapDataManager.h"
+#include "game/server/PacketLatencyStats.h"
 #include "ObjectMgr.h"
 
 #if PLATFORM == PLATFORM_WINDOWS
@@ -16,7 +17,12 @@
 
 World::World():
 	m_worldUpdateInterval(0),
-	m_updateDiff(0)
+	m_spinTime(0),
+	m_isFixedStep(false),
+	m_maxCatchUpSteps(0),
+	m_updateDiff(0),
+	m_overrunCount(0),
+	m_skippedStepCount(0)
 {
 
 }
@@ -52,7 +58,11 @@ bool World::initWorld()
 
 void World::loadConfigs()
 {
-	m_worldUpdateInterval = sConfigMgr->getIntDefault("WorldUpdateInterval", 50);
+	m_worldUpdateInterval = std::max(sConfigMgr->getIntDefault("WorldUpdateInterval", 50), 1);
+	m_spinTime = std::max(sConfigMgr->getIntDefault("WorldUpdateInterval.SpinTime", 1000), 0);
+	m_isFixedStep = sConfigMgr->getBoolDefault("WorldUpdateInterval.FixedStep", false);
+	m_maxCatchUpSteps = std::max(sConfigMgr->getIntDefault("WorldUpdateInterval.MaxCatchUpSteps", 3), 0);
+	sPacketLatencyStats->setEnabled(sConfigMgr->getBoolDefault("LatencyStats.Enable", true));
 
 	m_configs[CONFIG_WITHDRAWAL_DELAY] = sConfigMgr->getIntDefault("WithdrawalDelay", 2000);
 	m_configs[CONFIG_CONCEALED_DELAY] = sConfigMgr->getFloatDefault("ConcealedDelay", 2000);
@@ -64,6 +74,9 @@ void World::loadConfigs()
 	m_configs[CONFIG_BATTLE_END_AD_CHANCE] = sConfigMgr->getFloatDefault("BattleEndAdChance", 100.0f);
 	m_configs[CONFIG_BATTLE_ENABLE_APP_REVIEW_MODE] = sConfigMgr->getBoolDefault("EnableAppReviewMode", false);
 
+	m_configs[CONFIG_MAP_UPDATE_PROFILING_ENABLE] = sConfigMgr->getBoolDefault("MapUpdateProfiling.Enable", true);
+	m_configs[CONFIG_MAP_UPDATE_PROFILING_WINDOW] = std::max(sConfigMgr->getIntDefault("MapUpdateProfiling.Window", 60), 1);
+
 }
 
 bool World::getBoolConfig(int32 key)
@@ -151,37 +164,80 @@ void World::run()
 	sMapDataManager->unload();
 }
 
+void World::resetTickStats()
+{
+	m_tickDuration.reset();
+	m_tickLateness.reset();
+	m_overrunCount = 0;
+	m_skippedStepCount = 0;
+}
+
 void World::updateLoop()
 {
-	int64 realCurrTime = 0;
-	int64 realPrevTime = getUptimeMillis();
+	using namespace std::chrono;
+
+	Clock::duration const interval = milliseconds(m_worldUpdateInterval);
+	// The ticks are scheduled at fixed times, so the time a tick takes does not shift the following ticks
+	Clock::time_point deadline = Clock::now();
+	Clock::time_point prevTime = deadline;
+	int32 catchUpSteps = 0;
 
 	while (true)
 	{
-		realCurrTime = getUptimeMillis();
+		Clock::time_point startTime = Clock::now();
+		m_tickLateness.add(duration_cast<microseconds>(startTime - deadline).count());
 
-		m_updateDiff = static_cast<NSTime>(realCurrTime - realPrevTime);
-		realPrevTime = realCurrTime;
+		if (m_isFixedStep)
+			m_updateDiff = m_worldUpdateInterval;
+		else
+		{
+			// The part of the elapsed time below a millisecond is carried over to the next diff
+			m_updateDiff = static_cast<NSTime>(duration_cast<milliseconds>(startTime - prevTime).count());
+			prevTime += milliseconds(m_updateDiff);
+		}
 
 		if (!sTheaterManager->update(m_updateDiff))
 			break;
 
-		// Balance the tick duration close to WORLD_SLEEP_CONST
-		int64 executionTime = getUptimeMillis() - realPrevTime;
-		if (executionTime < m_worldUpdateInterval)
+		Clock::time_point endTime = Clock::now();
+		Clock::duration executionTime = endTime - startTime;
+		m_tickDuration.add(duration_cast<microseconds>(executionTime).count());
+		if (executionTime > interval)
+			++m_overrunCount;
+
+		deadline += interval;
+		if (endTime >= deadline)
 		{
-#if PLATFORM == PLATFORM_WINDOWS
-			// The precision of Windows Timer is set to the highest level (1ms) via "timeBeginPeriod()", but it is still not precise enough.
-			// For example, if the timer's precision is 1ms, then Sleep(3) may result in a sleep duration of 2ms or 4ms.
-			// Therefore, we subtract 1ms here to shorten the sleep duration. If “sleepTime” is equal to or less than 1ms, no sleep occurs, 
-			// and the program proceeds to the next loop to accurately advance the CPU to the next frame.
-			int64 sleepTime = m_worldUpdateInterval - executionTime - 1L;
-			if (sleepTime > 1L)
-				std::this_thread::sleep_for(std::chrono::milliseconds(sleepTime));
-#else
-			int64 sleepTime = m_worldUpdateInterval - executionTime;
-			std::this_thread::sleep_for(std::chrono::milliseconds(sleepTime));
-#endif  // PLATFORM_WINDOWS
+			// Behind schedule. A fixed step runs the next steps right away to catch up, up to the maximum steps.
+			// Otherwise the next tick starts now and its diff covers the elapsed time
+			if (m_isFixedStep && catchUpSteps < m_maxCatchUpSteps)
+			{
+				++catchUpSteps;
+				continue;
+			}
+
+			if (m_isFixedStep)
+				m_skippedStepCount += static_cast<uint64>((endTime - deadline) / interval);
+
+			deadline = endTime;
+			catchUpSteps = 0;
+			continue;
 		}
+
+		catchUpSteps = 0;
+		this->sleepUntil(deadline);
 	}
 }
+
+void World::sleepUntil(Clock::time_point deadline)
+{
+	// The sleep may overshoot by the resolution of the system timer, 
+	// so it ends the spin time early and the rest is spent polling the clock
+	Clock::duration spinTime = std::chrono::microseconds(m_spinTime);
+	Clock::time_point now = Clock::now();
+	if (deadline - now > spinTime)
+		std::this_thread::sleep_for(deadline - now - spinTime);
+
+	while (Clock::now() < deadline)
+		std::this_thread::yield();
+}
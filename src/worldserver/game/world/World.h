@@ -2,6 +2,7 @@
 #define __WORLD_H__
 
 #include "containers/Value.h"
+#include "utilities/Histogram.h"
 #include "game/server/WorldSession.h"
 
 enum WorldConfigs
@@ -13,6 +14,8 @@ enum WorldConfigs
 	CONFIG_BATTLE_PREPARATION_DURATION,
 	CONFIG_BATTLE_END_AD_CHANCE,
 	CONFIG_BATTLE_ENABLE_APP_REVIEW_MODE,
+	CONFIG_MAP_UPDATE_PROFILING_ENABLE,
+	CONFIG_MAP_UPDATE_PROFILING_WINDOW,
 };
 
 class World
@@ -41,15 +44,35 @@ public:
 
 	NSTime getUpdateDiff() const { return m_updateDiff; }
 
+	// Tick telemetry, in microseconds. The lateness is how long after its scheduled time a tick started
+	Histogram const& getTickDuration() const { return m_tickDuration; }
+	Histogram const& getTickLateness() const { return m_tickLateness; }
+	// The number of ticks that took longer than the update interval
+	uint64 getOverrunCount() const { return m_overrunCount; }
+	// The number of fixed steps given up because the world fell behind by more than the catch-up steps
+	uint64 getSkippedStepCount() const { return m_skippedStepCount; }
+	void resetTickStats();
+
 private:
+	typedef std::chrono::steady_clock Clock;
+
 	World();
 	~World();
 
 	void updateLoop();
+	void sleepUntil(Clock::time_point deadline);
 	
 	ValueMapIntKey m_configs;
 	int32 m_worldUpdateInterval;
+	int32 m_spinTime;
+	bool m_isFixedStep;
+	int32 m_maxCatchUpSteps;
 	NSTime m_updateDiff;
+
+	Histogram m_tickDuration;
+	Histogram m_tickLateness;
+	std::atomic<uint64> m_overrunCount;
+	std::atomic<uint64> m_skippedStepCount;
 };
 
 #define sWorld World::instance()